@@ -0,0 +1,279 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef __ALPHABET_H_INCLUDED__
+#define __ALPHABET_H_INCLUDED__
+
+#include <string.h>
+#include <limits.h>
+#include <functional>
+#include "csc.h"
+
+typedef unsigned long int       WORD;
+typedef unsigned __int128       WIDE_WORD;
+#define WORD_SIZE               sizeof(WORD) * 8
+#define KEY_SIZE(K)             (sizeof(K) * 8)
+#define ESCAPE_BIT(K)           ((K) 1 << (KEY_SIZE(K) - 1))
+
+/**
+ * The number of bits needed to tell sigma letters apart, ceil(log2(sigma))
+ */
+constexpr unsigned int bit_width(unsigned int sigma)
+{
+    return (sigma <= 1) ? 0 : 1 + bit_width((sigma + 1) / 2);
+}
+
+/**
+ * The longest q-gram whose base-radix value stays below the escape bit of K
+ */
+template <class K>
+constexpr unsigned int escape_width(K radix, K value = 1, unsigned int q = 0)
+{
+    return (value > (ESCAPE_BIT(K) - 1) / radix) ? q : escape_width<K>(radix, value * radix, q + 1);
+}
+
+/**
+ * Alphabet policies of the q-gram engines. The first sigma letters of
+ * letters() are packed with bits bits each; the letters past them escape:
+ * a q-gram holding one is keyed by its base-radix value over all the
+ * letters with the top bit set, so escaped q-grams never meet packed ones.
+ */
+struct TDNAAlphabet
+{
+    static const char * letters() { return DNA; }
+    static constexpr unsigned int sigma = 4;                    // A, C, G, T; N escapes
+    static constexpr unsigned int bits = bit_width(sigma);
+    static constexpr unsigned int radix = 5;
+};
+
+struct TRNAAlphabet
+{
+    static const char * letters() { return RNA; }
+    static constexpr unsigned int sigma = 4;                    // A, C, G, U; N escapes
+    static constexpr unsigned int bits = bit_width(sigma);
+    static constexpr unsigned int radix = 5;
+};
+
+struct TIUPACAlphabet
+{
+    static const char * letters() { return IUPAC; }
+    static constexpr unsigned int sigma = 16;
+    static constexpr unsigned int bits = bit_width(sigma);
+    static constexpr unsigned int radix = 0;                    // no escapes
+};
+
+struct TProteinAlphabet
+{
+    static const char * letters() { return PROT; }
+    static constexpr unsigned int sigma = 21;
+    static constexpr unsigned int bits = bit_width(sigma);
+    static constexpr unsigned int radix = 0;                    // no escapes
+};
+
+/**
+ * The code of every letter of alphabet A: its index in A::letters()
+ */
+template <class A>
+struct TLetterCodes
+{
+    unsigned char code[256];
+
+    TLetterCodes()
+    {
+	memset(code, 0, sizeof(code));
+	for (unsigned int i = 0; A::letters()[i]; i++) {
+	    code[(unsigned char) A::letters()[i]] = i;
+	}
+    }
+
+    static const unsigned char * table()
+    {
+	static const TLetterCodes<A> codes;
+	return codes.code;
+    }
+};
+
+/**
+ * Hashes a 128-bit key by folding its halves
+ */
+struct TWideWordHash
+{
+    size_t operator()(WIDE_WORD k) const
+    {
+	return std::hash<WORD>()((WORD) k ^ ((WORD) (k >> 64) * 0x9E3779B97F4A7C15UL));
+    }
+};
+
+template <class K> struct TKeyHash;
+template <> struct TKeyHash<WORD> { typedef std::hash<WORD> type; };
+template <> struct TKeyHash<WIDE_WORD> { typedef TWideWordHash type; };
+
+/**
+ * Rolling q-gram encoder over alphabet A into keys of type K: encode() keys
+ * the q-gram at s from scratch and roll() slides the q-gram one letter to
+ * the right. The keys are exact for q up to maxQ.
+ */
+template <class A, class K = WORD>
+class TQGramEncoder
+{
+public:
+    typedef A alphabet;
+    typedef K key_type;
+    typedef typename TKeyHash<K>::type hasher;
+    static constexpr unsigned int maxQ = A::radix ? escape_width<K>(A::radix) : KEY_SIZE(K) / A::bits;
+
+private:
+    const unsigned char * code;
+    unsigned int q;
+    K mask;             // the low q * bits bits
+    K key;              // the packed q-gram
+    K value;            // the base-radix q-gram, for escaping alphabets
+    K high;             // radix^(q-1)
+    unsigned int escapes;       // the number of escaping letters in the q-gram
+
+public:
+    TQGramEncoder(unsigned int q)
+    {
+	this->code = TLetterCodes<A>::table();
+	this->q = q;
+	this->mask = (q * A::bits >= KEY_SIZE(K)) ? ~(K) 0 : ((K) 1 << (q * A::bits)) - 1;
+	this->high = 1;
+	for (unsigned int i = 1; A::radix && i < q; i++) {
+	    this->high *= A::radix;
+	}
+	this->key = this->value = 0;
+	this->escapes = 0;
+    }
+
+    K current() const
+    {
+	return (A::radix && this->escapes) ? (ESCAPE_BIT(K) | this->value) : this->key;
+    }
+
+    K encode(const char * s)
+    {
+	this->key = this->value = 0;
+	this->escapes = 0;
+	for (unsigned int i = 0; i < this->q; i++) {
+	    unsigned int c = this->code[(unsigned char) s[i]];
+	    this->key = (this->key << A::bits) | (K) (c & ((1 << A::bits) - 1));
+	    if (A::radix) {
+		this->value = this->value * A::radix + c;
+		this->escapes += (c >= A::sigma);
+	    }
+	}
+	return this->current();
+    }
+
+    K roll(char out, char in)
+    {
+	unsigned int c = this->code[(unsigned char) in];
+	this->key = ((this->key << A::bits) | (K) (c & ((1 << A::bits) - 1))) & this->mask;
+	if (A::radix) {
+	    unsigned int o = this->code[(unsigned char) out];
+	    this->value = (this->value - o * this->high) * A::radix + c;
+	    this->escapes += (c >= A::sigma);
+	    this->escapes -= (o >= A::sigma);
+	}
+	return this->current();
+    }
+};
+
+/**
+ * The key of a q-gram too long to pack: a rolling hash of its letters and
+ * where the letters are, so that equal hashes are verified letter by letter
+ */
+struct TQGramRef
+{
+    WORD hash;
+    const char * s;
+    unsigned int q;
+
+    bool operator==(const TQGramRef & o) const
+    {
+	return this->hash == o.hash && memcmp(this->s, o.s, this->q) == 0;
+    }
+
+    bool operator<(const TQGramRef & o) const
+    {
+	return this->hash < o.hash || (this->hash == o.hash && memcmp(this->s, o.s, this->q) < 0);
+    }
+};
+
+struct TQGramRefHash
+{
+    size_t operator()(const TQGramRef & k) const
+    {
+	return k.hash;
+    }
+};
+
+/**
+ * Rolling q-gram hasher over alphabet A for any q: the keys point into the
+ * text, which must outlive them
+ */
+template <class A>
+class TQGramHasher
+{
+public:
+    typedef A alphabet;
+    typedef TQGramRef key_type;
+    typedef TQGramRefHash hasher;
+    static constexpr unsigned int maxQ = UINT_MAX;
+
+private:
+    static constexpr WORD base = 0x100000001B3UL;
+    TQGramRef key;
+    WORD high;          // base^(q-1)
+
+public:
+    TQGramHasher(unsigned int q)
+    {
+	this->key.hash = 0;
+	this->key.s = NULL;
+	this->key.q = q;
+	this->high = 1;
+	for (unsigned int i = 1; i < q; i++) {
+	    this->high *= base;
+	}
+    }
+
+    TQGramRef current() const
+    {
+	return this->key;
+    }
+
+    TQGramRef encode(const char * s)
+    {
+	this->key.hash = 0;
+	this->key.s = s;
+	for (unsigned int i = 0; i < this->key.q; i++) {
+	    this->key.hash = this->key.hash * base + (unsigned char) s[i];
+	}
+	return this->key;
+    }
+
+    TQGramRef roll(char out, char in)
+    {
+	this->key.hash = (this->key.hash - (unsigned char) out * this->high) * base + (unsigned char) in;
+	this->key.s++;
+	return this->key;
+    }
+};
+
+#endif
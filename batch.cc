@@ -0,0 +1,426 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <string>
+#include <deque>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "csc.h"
+#include "seqpack.h"
+#include "sacsc.h"
+#include "hcsc.h"
+#include "ncsc.h"
+
+using namespace std;
+
+#define BATCH_PENDING           4                       // pairs in flight per worker
+#define BATCH_BUFFER            ( 16 * ALLOC_SIZE )     // size of the output buffers
+
+struct TBatchPair
+{
+	unsigned int         index;                  // the position of the pair in the input
+	unsigned char *      x;
+	unsigned char *      x_id;
+	unsigned char *      y;
+	unsigned char *      y_id;
+	unsigned int         rotation;
+	unsigned int         distance;
+	unsigned int         valid;                  // 0 if the parameters do not fit the pair
+};
+
+/*
+The state shared by the three stages: the reader pushes pairs to todo, the
+workers move them to done and the writer takes them out of done in input
+order. pending counts the pairs read but not yet written and bounds the
+memory used when a slow pair holds back the writer.
+*/
+struct TBatch
+{
+	mutex                lock;
+	condition_variable   cv;
+	deque<TBatchPair *>  todo;
+	map<unsigned int, TBatchPair *> done;
+	unsigned int         pending;
+	unsigned int         max_pending;
+	unsigned int         num_pairs;              // the number of pairs read so far
+	bool                 eof;                    // the reader has finished
+	bool                 error;
+};
+
+/*
+Read the next (Multi)FASTA record; c holds the character following the
+previous record. Returns 1 on success, 0 at the end of the file and -1 on error.
+*/
+static int next_fasta_record ( FILE * in_fd, char * input_filename, char * alphabet, int * c, unsigned char ** seq_out, unsigned char ** seq_id_out )
+{
+	unsigned char * seq = NULL;
+	unsigned char * seq_id = NULL;
+	unsigned int seq_len, max_alloc_seq_len;
+	unsigned int seq_id_len, max_alloc_seq_id_len;
+
+	do
+	{
+		if ( ( * c ) == EOF )
+			return ( 0 );
+		if ( ( * c ) != '>' )
+		{
+			fprintf ( stderr, " Error: input file %s is not in FASTA format!\n", input_filename );
+			return ( -1 );
+		}
+
+		seq_id_len = max_alloc_seq_id_len = 0;
+		while ( ( ( * c ) = getc_unlocked ( in_fd ) ) != EOF && ( * c ) != '\n' )
+		{
+			if ( seq_id_len + 1 >= max_alloc_seq_id_len )
+			{
+				seq_id = ( unsigned char * ) realloc ( seq_id, ( max_alloc_seq_id_len + BUFSIZ ) * sizeof ( unsigned char ) );
+				max_alloc_seq_id_len += BUFSIZ;
+			}
+			seq_id[ seq_id_len++ ] = ( * c );
+		}
+		if ( seq_id == NULL )
+			seq_id = ( unsigned char * ) malloc ( sizeof ( unsigned char ) );
+		seq_id[ seq_id_len ] = '\0';
+
+		seq_len = max_alloc_seq_len = 0;
+		while ( ( ( * c ) = getc_unlocked ( in_fd ) ) != EOF && ( * c ) != '>' )
+		{
+			if ( ( * c ) == '\n' || ( * c ) == ' ' || ( * c ) == '\r' ) continue;
+
+			( * c ) = toupper ( * c );
+			if ( ! strchr ( alphabet, ( * c ) ) )
+			{
+				fprintf ( stderr, " Error: input file %s contains an unexpected character %c!\n", input_filename, ( * c ) );
+				free ( seq );
+				free ( seq_id );
+				return ( -1 );
+			}
+			if ( seq_len + 1 >= max_alloc_seq_len )
+			{
+				seq = ( unsigned char * ) realloc ( seq, ( max_alloc_seq_len + ALLOC_SIZE ) * sizeof ( unsigned char ) );
+				max_alloc_seq_len += ALLOC_SIZE;
+			}
+			seq[ seq_len++ ] = ( * c );
+		}
+
+		if ( seq_len == 0 )
+		{
+			fprintf ( stderr, " Omitting empty sequence in file %s!\n", input_filename );
+			free ( seq_id );
+			seq_id = NULL;
+		}
+	} while ( seq_len == 0 );
+
+	seq[ seq_len ] = '\0';
+	( * seq_out )    = ( unsigned char * ) realloc ( seq, ( seq_len + 1 ) * sizeof ( unsigned char ) );
+	( * seq_id_out ) = seq_id;
+	return ( 1 );
+}
+
+/* Decode sequence i of a packed container */
+static int next_packed_record ( struct TPack * p, uint64_t i, char * input_filename, char * alphabet, unsigned char ** seq, unsigned char ** seq_id )
+{
+	uint64_t len = pack_length ( p, i );
+	char * id = pack_id ( p, i );
+
+	( * seq )    = ( unsigned char * ) malloc ( ( len + 1 ) * sizeof ( unsigned char ) );
+	( * seq_id ) = ( unsigned char * ) malloc ( ( strlen ( id ) + 1 ) * sizeof ( unsigned char ) );
+	if ( ( * seq ) == NULL || ( * seq_id ) == NULL )
+	{
+		fprintf ( stderr, " Error: Cannot allocate memory for sequence %s!\n", id );
+		return ( -1 );
+	}
+	strcpy ( ( char * ) ( * seq_id ), id );
+	pack_decode ( p, i, ( * seq ) );
+	for ( uint64_t j = 0; j < len; j++ )
+	{
+		if ( ! strchr ( alphabet, ( * seq )[j] ) )
+		{
+			fprintf ( stderr, " Error: input file %s contains an unexpected character %c!\n", input_filename, ( * seq )[j] );
+			return ( -1 );
+		}
+	}
+	return ( 1 );
+}
+
+static void free_pair ( TBatchPair * p )
+{
+	free ( p -> x );
+	free ( p -> x_id );
+	free ( p -> y );
+	free ( p -> y_id );
+	delete p;
+}
+
+/*
+The reader stage: parse consecutive records into (x, y) pairs
+*/
+static void batch_reader ( struct TBatch * B, struct TSwitch * sw, char * alphabet )
+{
+	unsigned char * s[2];
+	unsigned char * s_id[2];
+	unsigned int n = 0;
+	int ret = 1;
+
+	FILE * in_fd = NULL;
+	struct TPack p;
+	uint64_t num_packed = 0;
+	uint64_t next_packed = 0;
+	int c = EOF;
+	int packed = pack_is_packed ( sw -> input_filename );
+	int opened = 0;
+
+	if ( packed )
+	{
+		if ( ! ( opened = pack_open ( sw -> input_filename, &p ) ) )
+			ret = -1;
+		else
+			num_packed = pack_num_seqs ( &p );
+	}
+	else if ( ! ( in_fd = fopen ( sw -> input_filename, "r" ) ) )
+	{
+		fprintf ( stderr, " Error: Cannot open file %s!\n", sw -> input_filename );
+		ret = -1;
+	}
+	else
+	{
+		setvbuf ( in_fd, NULL, _IOFBF, BATCH_BUFFER );
+		c = getc_unlocked ( in_fd );
+	}
+
+	while ( ret > 0 )
+	{
+		if ( packed )
+			ret = ( next_packed < num_packed ) ? next_packed_record ( &p, next_packed++, sw -> input_filename, alphabet, &s[n], &s_id[n] ) : 0;
+		else
+			ret = next_fasta_record ( in_fd, sw -> input_filename, alphabet, &c, &s[n], &s_id[n] );
+		if ( ret <= 0 )
+			break;
+		if ( ++n < 2 )
+			continue;
+		n = 0;
+
+		TBatchPair * pair = new TBatchPair;
+		pair -> x        = s[0];
+		pair -> x_id     = s_id[0];
+		pair -> y        = s[1];
+		pair -> y_id     = s_id[1];
+		pair -> rotation = 0;
+		pair -> distance = 0;
+		pair -> valid    = 0;
+
+		unique_lock<mutex> lk ( B -> lock );
+		B -> cv . wait ( lk, [B] { return B -> pending < B -> max_pending || B -> error; } );
+		if ( B -> error )
+		{
+			free_pair ( pair );
+			break;
+		}
+		pair -> index = B -> num_pairs++;
+		B -> pending++;
+		B -> todo . push_back ( pair );
+		B -> cv . notify_all ();
+	}
+
+	if ( n == 1 && ret == 0 )
+	{
+		fprintf ( stderr, " Warning: Ignoring the unpaired last sequence %s.\n", s_id[0] );
+	}
+	if ( n == 1 )
+	{
+		free ( s[0] );
+		free ( s_id[0] );
+	}
+	if ( opened )
+		pack_close ( &p );
+	if ( in_fd )
+		fclose ( in_fd );
+
+	lock_guard<mutex> lk ( B -> lock );
+	B -> eof = true;
+	if ( ret < 0 )	B -> error = true;
+	B -> cv . notify_all ();
+}
+
+/*
+Compare one pair with the chosen method
+*/
+static void batch_compare ( TBatchPair * pair, struct TSwitch * sw, char * method, char * alphabet )
+{
+	unsigned int m = strlen ( ( char * ) pair -> x );
+	unsigned int n = strlen ( ( char * ) pair -> y );
+
+	if ( sw -> l < 1 || sw -> q >= sw -> l || sw -> l > m - sw -> q + 1 || sw -> l > n - sw -> q + 1 || sw -> q > m || sw -> q > n )
+		return;
+	if ( sw -> P > 0 && sw -> P >= ( m / sw -> l ) / 2 )
+		return;
+
+	if ( strcmp ( method, METHOD_SA ) == 0 )
+	{
+		struct TSwitch one = * sw;	//the workers already use the threads
+		one . T = 1;
+		if ( sw -> P > 0 )
+			pair -> valid = sacsc_refinement ( pair -> x, pair -> y, one, &pair -> rotation, &pair -> distance, NULL, NULL ) == EXIT_SUCCESS;
+		else
+			pair -> valid = circular_sequence_comparison ( pair -> x, pair -> y, one, &pair -> rotation, &pair -> distance, NULL, NULL );
+		return;
+	}
+
+	struct BestMatch bm;
+	string xx ( ( char * ) pair -> x );
+	xx = xx + xx;
+	string ys ( ( char * ) pair -> y );
+	if ( strcmp ( method, METHOD_N ) == 0 )
+		runQGramEngine<nCSC> ( xx, 2 * m, ys, n, sw -> q, sw -> l, alphabet, sw -> candidates, 1, NULL, NULL, &bm );
+	else
+		runQGramEngine<hCSC> ( xx, 2 * m, ys, n, sw -> q, sw -> l, alphabet, sw -> candidates, 1, NULL, NULL, &bm );
+	pair -> distance = bm . score;
+	pair -> rotation = bm . pos;
+	pair -> valid = 1;
+}
+
+/*
+The worker stage: compare the pairs taken from todo and hand them to the writer
+*/
+static void batch_worker ( struct TBatch * B, struct TSwitch * sw, char * method, char * alphabet )
+{
+	while ( true )
+	{
+		TBatchPair * pair;
+		{
+			unique_lock<mutex> lk ( B -> lock );
+			B -> cv . wait ( lk, [B] { return ! B -> todo . empty () || B -> eof || B -> error; } );
+			if ( B -> todo . empty () || B -> error )
+				return;
+			pair = B -> todo . front ();
+			B -> todo . pop_front ();
+		}
+
+		batch_compare ( pair, sw, method, alphabet );
+
+		lock_guard<mutex> lk ( B -> lock );
+		B -> done[pair -> index] = pair;
+		B -> cv . notify_all ();
+	}
+}
+
+/*
+Compare the consecutive pairs of sequences of the input file: a reader thread
+streams the records into a bounded queue, sw . T workers compare them and the
+calling thread writes, in input order, the rotated pairs to the output file
+and one result row per pair to the standard output.
+*/
+int batch_comparison ( struct TSwitch sw, char * method, char * alphabet )
+{
+	FILE * out_fd;
+	struct TBatch B;
+	unsigned int written = 0;
+	unsigned int skipped = 0;
+
+	if ( ! ( out_fd = fopen ( sw . output_filename, "w" ) ) )
+	{
+		fprintf ( stderr, " Error: Cannot open file %s!\n", sw . output_filename );
+		return ( 0 );
+	}
+	setvbuf ( out_fd, NULL, _IOFBF, BATCH_BUFFER );
+	setvbuf ( stdout, NULL, _IOFBF, ALLOC_SIZE );
+
+	if ( strcmp ( method, METHOD_SA ) == 0 && sw . P > 0 )
+		init_substitution_score_tables ();
+
+	B . pending     = 0;
+	B . max_pending = BATCH_PENDING * sw . T;
+	B . num_pairs   = 0;
+	B . eof         = false;
+	B . error       = false;
+
+	thread reader ( batch_reader, &B, &sw, alphabet );
+	vector<thread> workers;
+	for ( unsigned int i = 0; i < sw . T; i++ )
+		workers . push_back ( thread ( batch_worker, &B, &sw, method, alphabet ) );
+
+	fprintf ( stdout, "#x_id\ty_id\tx_length\ty_length\tdistance\trotation\n" );
+	while ( true )
+	{
+		TBatchPair * pair;
+		{
+			unique_lock<mutex> lk ( B . lock );
+			B . cv . wait ( lk, [&B, written] { return B . done . count ( written ) || B . error || ( B . eof && written == B . num_pairs ); } );
+			if ( B . error || ! B . done . count ( written ) )
+				break;
+			pair = B . done[written];
+			B . done . erase ( written );
+		}
+
+		unsigned int m = strlen ( ( char * ) pair -> x );
+		unsigned int n = strlen ( ( char * ) pair -> y );
+		if ( pair -> valid )
+		{
+			/* The rotation is written in two pieces straight from x */
+			fprintf ( out_fd, ">%s\n", pair -> x_id );
+			fwrite ( pair -> x + pair -> rotation, sizeof ( unsigned char ), m - pair -> rotation, out_fd );
+			fwrite ( pair -> x, sizeof ( unsigned char ), pair -> rotation, out_fd );
+			fprintf ( out_fd, "\n>%s\n", pair -> y_id );
+			fwrite ( pair -> y, sizeof ( unsigned char ), n, out_fd );
+			fputc ( '\n', out_fd );
+			fprintf ( stdout, "%s\t%s\t%u\t%u\t%u\t%u\n", pair -> x_id, pair -> y_id, m, n, pair -> distance, pair -> rotation );
+		}
+		else
+		{
+			fprintf ( stderr, " Warning: Skipping pair (%s, %s): illegal q-gram length, block length or P.\n", pair -> x_id, pair -> y_id );
+			skipped++;
+		}
+		free_pair ( pair );
+
+		lock_guard<mutex> lk ( B . lock );
+		written++;
+		B . pending--;
+		B . cv . notify_all ();
+	}
+
+	if ( B . error )
+	{
+		lock_guard<mutex> lk ( B . lock );
+		B . cv . notify_all ();
+	}
+	reader . join ();
+	for ( auto & t : workers )	t . join ();
+	for ( auto & d : B . done )	free_pair ( d . second );
+	for ( auto & d : B . todo )	free_pair ( d );
+
+	fflush ( stdout );
+	if ( fclose ( out_fd ) )
+	{
+		fprintf ( stderr, " Error: file close error!\n" );
+		return ( 0 );
+	}
+	if ( B . error )
+		return ( 0 );
+
+	fprintf ( stderr, " Compared %u pairs (%u skipped)\n", written - skipped, skipped );
+	return ( 1 );
+}
@@ -23,16 +23,51 @@
 #include <string>
 #include <sys/time.h>
 #include "csc.h"
+#include "seqpack.h"
 #include "sacsc.h"
 #include "hcsc.h"
 #include "ncsc.h"
 
+/* De-allocate the input sequences and the switches */
+static void release ( unsigned char ** seq, unsigned char ** seq_id, unsigned int num_seqs, struct TSwitch * sw )
+{
+        for ( unsigned int i = 0; i < num_seqs; i ++ )
+        {
+                free ( seq[i] );
+                free ( seq_id[i] );
+        }
+        free ( seq );
+        free ( seq_id );
+
+        free ( sw -> input_filename );
+        free ( sw -> output_filename );
+        free ( sw -> alphabet );
+        free ( sw -> method );
+        free ( sw -> profile_filename );
+        free ( sw -> qs );
+        free ( sw -> ls );
+        free ( sw -> build_index_filename );
+        free ( sw -> index_filename );
+        free ( sw -> pack_filename );
+        free ( sw -> pairs_filename );
+}
+
+/* Write sequence s rotated by rot as a FASTA record */
+static void write_rotation ( FILE * out_fd, unsigned char * id, unsigned char * s, unsigned int rot )
+{
+        unsigned int m = strlen ( ( char * ) s );
+
+        fprintf( out_fd, ">%s\n", id );
+        fwrite ( s + rot, sizeof ( unsigned char ), m - rot, out_fd );
+        fwrite ( s, sizeof ( unsigned char ), rot, out_fd );
+        fputc ( '\n', out_fd );
+}
+
 int main(int argc, char **argv)
 {
 
 	struct TSwitch  sw;
 
-	FILE *           in_fd;                  // the input file descriptor
 	FILE *           out_fd;                 // the input file descriptor
         char *           input_filename;         // the input file name
         char *           output_filename;        // the output file name
@@ -44,10 +79,34 @@ int main(int argc, char **argv)
 	double           P;                      // the program parameters
 	
 	unsigned int     h, i, j, k;
+	unsigned int     num_seqs = 0;           // the number of sequences in memory
+	unsigned int     total_seqs = 0;         // the number of sequences in the input file
 
 	/* Decodes the arguments */
         i = decode_switches ( argc, argv, &sw );
 	
+	/* Convert the input into a packed sequence file and exit */
+	if ( i > 0 && sw . pack_filename )
+	{
+		int coding;
+                if      ( ! strcmp ( ALPHABET_DNA, sw . alphabet ) )   { alphabet = ( char * ) DNA;  coding = PACK_DNA;  }
+                else if ( ! strcmp ( ALPHABET_RNA, sw . alphabet ) )   { alphabet = ( char * ) RNA;  coding = PACK_RNA;  }
+                else if ( ! strcmp ( ALPHABET_PROT, sw . alphabet ) )  { alphabet = ( char * ) PROT; coding = PACK_PROT; }
+                else if ( ! strcmp ( ALPHABET_IUPAC, sw . alphabet ) ) { alphabet = ( char * ) IUPAC; coding = PACK_DNA; }
+                else
+                {
+                        fprintf ( stderr, " Error: alphabet argument a should be `DNA', `RNA' or `IUPAC' for nucleotide sequences or `PROT' for protein sequences!\n" );
+                        return ( 1 );
+                }
+		double start = gettime();
+		if ( ! pack_fasta ( sw . input_filename, sw . pack_filename, alphabet, coding ) )
+			return ( 1 );
+		fprintf( stderr, " Packed sequence file     : %s\n",       sw . pack_filename );
+		fprintf( stderr, "Elapsed time for packing sequences: %lf secs\n", ( gettime() - start ) );
+		release ( seq, seq_id, num_seqs, &sw );
+		return ( 0 );
+	}
+
 	/* Check the arguments */
         if ( i < 10 )
         {
@@ -59,18 +118,20 @@ int main(int argc, char **argv)
                 if      ( ! strcmp ( METHOD_H, sw . method ) )   method = ( char * ) METHOD_H;
                 else if ( ! strcmp ( METHOD_N, sw . method ) )   method = ( char * ) METHOD_N;
                 else if ( ! strcmp ( METHOD_SA, sw . method ) )  method = ( char * ) METHOD_SA;
+                else if ( ! strcmp ( METHOD_AUTO, sw . method ) ) method = ( char * ) METHOD_AUTO;
                 else
                 {
-                        fprintf ( stderr, " Error: Method argument should be `hCSC', `nCSC' or `saCSC' for heuristic, naive or suffix-array Circular Sequence Comparison.\n" );
+                        fprintf ( stderr, " Error: Method argument should be `hCSC', `nCSC' or `saCSC' for heuristic, naive or suffix-array Circular Sequence Comparison, or `auto'.\n" );
                         return ( 1 );
                 }
 
                 if      ( ! strcmp ( ALPHABET_DNA, sw . alphabet ) )   alphabet = ( char * ) DNA;
                 else if ( ! strcmp ( ALPHABET_RNA, sw . alphabet ) )   alphabet = ( char * ) RNA;
                 else if ( ! strcmp ( ALPHABET_PROT, sw . alphabet ) )  alphabet = ( char * ) PROT;
+                else if ( ! strcmp ( ALPHABET_IUPAC, sw . alphabet ) ) alphabet = ( char * ) IUPAC;
                 else
                 {
-                        fprintf ( stderr, " Error: alphabet argument a should be `DNA' or 'RNA' for nucleotide sequences or `PROT' for protein sequences!\n" );
+                        fprintf ( stderr, " Error: alphabet argument a should be `DNA', `RNA' or `IUPAC' for nucleotide sequences or `PROT' for protein sequences!\n" );
                         return ( 1 );
                 }
 
@@ -106,117 +167,206 @@ int main(int argc, char **argv)
                 output_filename         = sw . output_filename;
         }
 
+	/* The modes only saCSC supports leave -m auto no choice */
+	if ( strcmp ( method, METHOD_AUTO ) == 0 && ( sw . batch || sw . all_vs_all || sw . multi || sw . pairs_filename || sw . both || sw . index_filename || sw . build_index_filename ||
+		sw . nq > 1 || sw . nl > 1 || sw . P > 0 || sw . anchor || sw . fft || sw . stride ) )
+	{
+		fprintf( stderr, " Method chosen by planner : %s (the only engine supporting the chosen mode)\n", METHOD_SA );
+		method = ( char * ) METHOD_SA;
+	}
+
+	if ( ( sw . anchor || sw . fft || sw . stride ) && ( strcmp ( method, METHOD_SA ) != 0 || sw . batch || sw . all_vs_all || sw . multi || sw . pairs_filename || sw . both || sw . index_filename || sw . build_index_filename || sw . profile_filename || sw . nq > 1 || sw . nl > 1 ) )
+	{
+		fprintf( stderr, " Error: Anchors, FFT shortlists and coarse-to-fine searches are only supported by saCSC on a single pair without -b, -A, -M, -p, -D, -B, -X, -R or lists of q and l values.\n" );
+		return ( 1 );
+	}
+
+	if ( sw . time_limit > 0 && ( sw . batch || sw . all_vs_all || sw . multi || sw . pairs_filename || sw . both || sw . index_filename || sw . build_index_filename || sw . profile_filename || sw . nq > 1 || sw . nl > 1 ) )
+	{
+		fprintf( stderr, " Error: A time limit is only supported on a single pair without -b, -A, -M, -p, -D, -B, -X, -R or lists of q and l values.\n" );
+		return ( 1 );
+	}
+
+	if ( sw . stride && ( sw . anchor || sw . fft ) )
+	{
+		fprintf( stderr, " Error: The coarse-to-fine search cannot be combined with -K or -F.\n" );
+		return ( 1 );
+	}
+
+	if ( ( sw . q == 0 || sw . l == 0 ) && ( sw . batch || sw . all_vs_all || sw . multi || sw . pairs_filename || sw . index_filename || sw . build_index_filename || sw . nq > 1 || sw . nl > 1 ) )
+	{
+		fprintf( stderr, " Error: Tuning q and l is only supported on a single pair without -b, -A, -M, -p, -B, -X or lists of q and l values.\n" );
+		return ( 1 );
+	}
+
 	double start = gettime();
+	deadline_start ( sw . time_limit );
+
+	/* Stream the consecutive pairs of the input through the comparison pipeline and exit */
+	if ( sw . batch )
+	{
+		if ( sw . index_filename || sw . build_index_filename || sw . nq > 1 || sw . nl > 1 || sw . k > 1 || sw . profile_filename )
+		{
+			fprintf( stderr, " Error: Batch mode cannot be combined with -B, -X, -k, -R or lists of q and l values.\n" );
+			return ( 1 );
+		}
+		fprintf ( stderr, " Comparing the pairs of the input file: %s\n", input_filename );
+		if ( ! batch_comparison ( sw, method, alphabet ) )
+			return ( 1 );
+		fprintf( stderr, " (Multi)FASTA output file : %s\n",       sw . output_filename );
+		fprintf( stderr, "Elapsed time for comparing sequences: %lf secs\n", ( gettime() - start ) );
+		release ( seq, seq_id, num_seqs, &sw );
+		return ( 0 );
+	}
 
         /* Read the (Multi)FASTA file in memory */
         fprintf ( stderr, " Reading the (Multi)FASTA input file: %s\n", input_filename );
-        if ( ! ( in_fd = fopen ( input_filename, "r") ) )
+        if ( pack_is_packed ( input_filename ) )
+        {
+                if ( ! read_packed ( input_filename, alphabet, ( sw . all_vs_all || sw . multi || sw . pairs_filename ) ? UINT_MAX : 2, &seq, &seq_id, &num_seqs, &total_seqs ) )
+                        return ( 1 );
+        }
+        else if ( ! read_fasta ( input_filename, alphabet, &seq, &seq_id, &num_seqs ) )
         {
-                fprintf ( stderr, " Error: Cannot open file %s!\n", input_filename );
                 return ( 1 );
         }
-
-        char c;
-        unsigned int num_seqs = 0;           	// the total number of sequences considered
-        unsigned int total_length = 0;          // the total number of sequences considered
-        unsigned int max_alloc_seq_id = 0;
-        unsigned int max_alloc_seq = 0;
-        c = fgetc( in_fd );
-        do
+        else
         {
-                if ( c != '>' )
-                {
-                        fprintf ( stderr, " Error: input file %s is not in FASTA format!\n", input_filename );
-                        return ( 1 );
-                }
-                else
-                {
-                        if ( num_seqs >= max_alloc_seq_id )
-                        {
-                                seq_id = ( unsigned char ** ) realloc ( seq_id,   ( max_alloc_seq_id + ALLOC_SIZE ) * sizeof ( unsigned char * ) );
-                                max_alloc_seq_id += ALLOC_SIZE;
-                        }
-
-                        unsigned int max_alloc_seq_id_len = 0;
-                        unsigned int seq_id_len = 0;
-
-                        seq_id[ num_seqs ] = NULL;
-
-                        while ( ( c = fgetc( in_fd ) ) != EOF && c != '\n' )
-                        {
-                                if ( seq_id_len >= max_alloc_seq_id_len )
-                                {
-                                        seq_id[ num_seqs ] = ( unsigned char * ) realloc ( seq_id[ num_seqs ],   ( max_alloc_seq_id_len + ALLOC_SIZE ) * sizeof ( unsigned char ) );
-                                        max_alloc_seq_id_len += ALLOC_SIZE;
-                                }
-                                seq_id[ num_seqs ][ seq_id_len++ ] = c;
-                        }
-                        seq_id[ num_seqs ][ seq_id_len ] = '\0';
-
-                }
-		if ( num_seqs >= max_alloc_seq )
-                {
-                        seq = ( unsigned char ** ) realloc ( seq,   ( max_alloc_seq + ALLOC_SIZE ) * sizeof ( unsigned char * ) );
-                        max_alloc_seq += ALLOC_SIZE;
-                }
-
-                unsigned int seq_len = 0;
-                unsigned int max_alloc_seq_len = 0;
-
-                seq[ num_seqs ] = NULL;
+                total_seqs = num_seqs;
+        }
 
-                while ( ( c = fgetc( in_fd ) ) != EOF && c != '>' )
-                {
-                        if( seq_len == 0 && c == '\n' )
-                        {
-                                fprintf ( stderr, " Omitting empty sequence in file %s!\n", input_filename );
-                                c = fgetc( in_fd );
-                                break;
-                        }
-                        if( c == '\n' || c == ' ' ) continue;
-
-                        c = toupper( c );
-
-                        if ( seq_len >= max_alloc_seq_len )
-                        {
-                                seq[ num_seqs ] = ( unsigned char * ) realloc ( seq[ num_seqs ],   ( max_alloc_seq_len + ALLOC_SIZE ) * sizeof ( unsigned char ) );
-                                max_alloc_seq_len += ALLOC_SIZE;
-                        }
-
-                        if( strchr ( alphabet, c ) )
-                        {
-                                seq[ num_seqs ][ seq_len++ ] = c;
-                        }
-                        else
-                        {
-                                fprintf ( stderr, " Error: input file %s contains an unexpected character %c!\n", input_filename, c );
-                                return ( 1 );
-                        }
+	/* Compare all the pairs of the collection, or x against every query, on a single index and exit */
+	if ( sw . all_vs_all || sw . multi || sw . pairs_filename )
+	{
+		if ( strcmp ( method, METHOD_SA ) != 0 || sw . P > 0 || sw . index_filename || sw . build_index_filename || sw . nq > 1 || sw . nl > 1 )
+		{
+			fprintf( stderr, " Error: All-vs-all, multi-query and pairs-list comparisons are only supported by saCSC without -P, -B, -X or lists of q and l values.\n" );
+			return ( 1 );
+		}
+		if ( num_seqs < 2 )
+		{
+			fprintf( stderr, " Error: Two sequences are required in file %s.\n", input_filename );
+			return ( 1 );
+		}
+		if ( ! ( out_fd = fopen ( output_filename, "w") ) )
+		{
+			fprintf ( stderr, " Error: Cannot open file %s!\n", output_filename );
+			return ( 1 );
+		}
+		if ( sw . all_vs_all && ! sacsc_all_vs_all ( seq, seq_id, num_seqs, sw, out_fd ) )
+			return ( 1 );
+		if ( ! sw . all_vs_all && sw . multi && ! sacsc_multi_query ( seq, seq_id, num_seqs, sw, out_fd ) )
+			return ( 1 );
+		if ( ! sw . all_vs_all && ! sw . multi && ! sacsc_pairs_list ( seq, seq_id, num_seqs, sw, out_fd ) )
+			return ( 1 );
+		if ( fclose ( out_fd ) )
+		{
+			fprintf( stderr, " Error: file close error!\n");
+			return ( 1 );
+		}
+		double end = gettime();
+		fprintf( stderr, " Compared %u sequences on one collection index\n", num_seqs );
+		if ( sw . multi )
+			fprintf( stderr, " Queries per pass over x is %u\n",   sw . multi );
+		fprintf( stderr, " q-gram length is %d\n",                 sw . q );
+		fprintf( stderr, " Block length is %d\n",                  sw . l );
+		fprintf( stderr, " Result rows output file  : %s\n",       sw . output_filename );
+		fprintf( stderr, "Elapsed time for comparing sequences: %lf secs\n", ( end - start ) );
+		release ( seq, seq_id, num_seqs, &sw );
+		return ( 0 );
+	}
 
-                }
+	/* Build the index of the reference x and exit */
+	if ( sw . build_index_filename )
+	{
+		unsigned int m = strlen ( ( char * ) seq[0] );
+		if ( sw . l < 1 || sw . q < 1 || sw . q >= sw . l || sw . l > m - sw . q + 1 )
+		{
+			fprintf( stderr, " Error: Illegal q-gram or block length.\n" );
+			return ( 1 );
+		}
+		if ( ! sacsc_build_index ( seq[0], seq_id[0], sw, sw . build_index_filename ) )
+			return ( 1 );
+		double end = gettime();
+		fprintf( stderr, " Seq x id is %s and its length is %d\n", seq_id[0], m );
+		fprintf( stderr, " q-gram length is %d\n",                 sw . q );
+		fprintf( stderr, " Block length is %d\n",                  sw . l );
+		fprintf( stderr, " Index file               : %s\n",       sw . build_index_filename );
+		fprintf( stderr, "Elapsed time for building the index: %lf secs\n", ( end - start ) );
+		release ( seq, seq_id, num_seqs, &sw );
+		return ( 0 );
+	}
 
-                if( seq_len != 0 )
-                {
-                        if ( seq_len >= max_alloc_seq_len )
-                        {
-                                seq[ num_seqs ] = ( unsigned char * ) realloc ( seq[ num_seqs ],   ( max_alloc_seq_len + ALLOC_SIZE ) * sizeof ( unsigned char ) );
-                                max_alloc_seq_len += ALLOC_SIZE;
-                        }
-                        seq[ num_seqs ][ seq_len ] = '\0';
-                        total_length += seq_len;
-                        num_seqs++;
-                }
+	/* Compare the indexed reference x against the first input sequence */
+	unsigned char * x    = seq[0];
+	unsigned char * x_id = seq_id[0];
+	unsigned char * y    = ( num_seqs > 1 ) ? seq[1] : NULL;
+	unsigned char * y_id = ( num_seqs > 1 ) ? seq_id[1] : NULL;
+	struct TIndex   idx;
+	if ( sw . index_filename )
+	{
+		if ( strcmp ( method, METHOD_SA ) != 0 || sw . P > 0 )
+		{
+			fprintf( stderr, " Error: An index file can only be used with saCSC without refinement.\n" );
+			return ( 1 );
+		}
+		if ( ! sacsc_load_index ( sw . index_filename, &idx ) )
+			return ( 1 );
+		if ( sw . q != idx . q || sw . l != idx . l )
+			fprintf( stderr, " Warning: Using q-gram length %ld and block length %ld of index %s.\n", ( long ) idx . q, ( long ) idx . l, sw . index_filename );
+		sw . q = idx . q;
+		sw . l = idx . l;
+		x    = idx . x;
+		x_id = idx . x_id;
+		y    = seq[0];
+		y_id = seq_id[0];
+	}
+	else if ( num_seqs < 2 )
+	{
+		fprintf( stderr, " Error: Two sequences are required in file %s.\n", input_filename );
+		return ( 1 );
+	}
 
-        } while( c != EOF );
+	unsigned int m = strlen ( ( char * ) x );
+	unsigned int n = strlen ( ( char * ) y );
 
-	if ( fclose ( in_fd ) )
+	/* A q or l of 0 is tuned on the q-gram statistics of the pair */
+	if ( sw . q == 0 || sw . l == 0 )
 	{
-		fprintf( stderr, " Error: file close error!\n");
-		return ( 1 );
+		if ( ! sacsc_tune ( x, y, &sw ) )
+			return ( 1 );
 	}
 
-	unsigned int m = strlen ( ( char * ) seq[0] );
-	unsigned int n = strlen ( ( char * ) seq[1] );
+	/* Sweep over lists of q and l values sharing a single index */
+	if ( sw . nq > 1 || sw . nl > 1 )
+	{
+		if ( strcmp ( method, METHOD_SA ) != 0 )
+		{
+			fprintf( stderr, " Error: Lists of q and l values are only supported by saCSC.\n" );
+			return ( 1 );
+		}
+		if ( ! ( out_fd = fopen ( output_filename, "w") ) )
+		{
+			fprintf ( stderr, " Error: Cannot open file %s!\n", output_filename );
+			return ( 1 );
+		}
+		if ( ! sacsc_sweep ( x, y, sw, out_fd ) )
+			return ( 1 );
+		if ( fclose ( out_fd ) )
+		{
+			fprintf( stderr, " Error: file close error!\n");
+			return ( 1 );
+		}
+		double end = gettime();
+		fprintf( stderr, " Seq x id is %s and its length is %d\n", x_id, m );
+		fprintf( stderr, " Seq y id is %s and its length is %d\n", y_id, n );
+		fprintf( stderr, " Swept %u q-gram lengths and %u block lengths\n", sw . nq, sw . nl );
+		fprintf( stderr, " Sweep output file        : %s\n",       sw . output_filename );
+		fprintf( stderr, "Elapsed time for comparing sequences: %lf secs\n", ( end - start ) );
+
+		release ( seq, seq_id, num_seqs, &sw );
+		return ( 0 );
+	}
 
 	if ( sw . l < 1 || sw . l > m - sw . q + 1  || sw . l > n - sw . q + 1 )
 	{
@@ -236,10 +386,66 @@ int main(int argc, char **argv)
 		return ( 1 );
 	}
 
-	if ( num_seqs > 2 )
+	if ( total_seqs > 2 )
+	{
+        	fprintf( stderr, " Warning: %d sequences were read from file %s.\n", total_seqs, input_filename );
+        	fprintf( stderr, " Warning: Only the first two (%s, %s) will be processed!\n", x_id, y_id );
+	}
+
+	/* Compare x against y and y against x on a single index and exit */
+	if ( sw . both )
 	{
-        	fprintf( stderr, " Warning: %d sequences were read from file %s.\n", num_seqs, input_filename );
-        	fprintf( stderr, " Warning: Only the first two (%s, %s) will be processed!\n", seq_id[0], seq_id[1] );
+		unsigned int rot[2], dist[2];
+		if ( strcmp ( method, METHOD_SA ) != 0 || sw . P > 0 || sw . index_filename || sw . k > 1 || sw . profile_filename )
+		{
+			fprintf( stderr, " Error: Both directions are only supported by saCSC without -P, -X, -k or -R.\n" );
+			return ( 1 );
+		}
+		if ( sw . l > n - sw . q + 1 || sw . l > m - sw . q + 1 )
+		{
+			fprintf( stderr, " Error: Illegal block length.\n" );
+			return ( 1 );
+		}
+		if ( ! sacsc_both_directions ( x, y, sw, rot, dist ) )
+			return ( 1 );
+		if ( ! ( out_fd = fopen ( output_filename, "w") ) )
+		{
+			fprintf ( stderr, " Error: Cannot open file %s!\n", output_filename );
+			return ( 1 );
+		}
+		write_rotation ( out_fd, x_id, x, rot[0] );
+		write_rotation ( out_fd, y_id, y, 0 );
+		write_rotation ( out_fd, y_id, y, rot[1] );
+		write_rotation ( out_fd, x_id, x, 0 );
+		if ( fclose ( out_fd ) )
+		{
+			fprintf( stderr, " Error: file close error!\n");
+			return ( 1 );
+		}
+		double end = gettime();
+		fprintf( stderr, " Seq x id is %s and its length is %d\n", x_id, m );
+		fprintf( stderr, " Seq y id is %s and its length is %d\n", y_id, n );
+		fprintf( stderr, " q-gram length is %d\n",                 sw . q );
+		fprintf( stderr, " Block length is %d\n",                  sw . l );
+		fprintf( stderr, " x against y: blockwise q-gram distance %u, rotation %u (%d blocks)\n", dist[0], rot[0], m / sw . l );
+		fprintf( stderr, " y against x: blockwise q-gram distance %u, rotation %u (%d blocks)\n", dist[1], rot[1], n / sw . l );
+		fprintf( stderr, " (Multi)FASTA output file : %s\n",       sw . output_filename );
+		fprintf( stderr, "Elapsed time for comparing sequences: %lf secs\n", ( end - start ) );
+		release ( seq, seq_id, num_seqs, &sw );
+		return ( 0 );
+	}
+
+	/* Choose the engine predicted fastest within the memory limit */
+	struct TPlan plan;
+	if ( strcmp ( method, METHOD_AUTO ) == 0 )
+	{
+		static const char * engines[PLAN_ENGINES] = { METHOD_SA, METHOD_N, METHOD_H };
+		method = plan_method ( m, n, sw, strlen ( alphabet ), &plan );
+		for ( i = 0; i < PLAN_ENGINES; i++ )
+			fprintf( stderr, " Planner: %-5s predicted %.3g secs and %.3g MB%s\n", engines[i], plan . time[i], plan . memory[i] / 1048576.0,
+				plan . allowed[i] ? "" : " (heuristic, not allowed without -H)" );
+		if ( ! plan . fits )
+			fprintf( stderr, " Warning: No engine is predicted to fit in %g MB; using the one needing the least memory.\n", sw . memory_limit );
 	}
 
 	unsigned int distance = m + n;
@@ -248,56 +454,72 @@ int main(int argc, char **argv)
 	D . err = UINT_MAX;
 
 	/* Run the algorithm using the user's chosen method - Naive method does not go through repeats */
-	string xx ( ( char * ) seq[0] );
+	string xx ( ( char * ) x );
 	xx = xx + xx;
-	string y ( ( char * ) seq[1] );
-	string alphabetLetters = "";
-	if ( strcmp ( sw . alphabet, ALPHABET_DNA ) == 0 )
-	{
-		alphabetLetters = DNA;
-	}
-	else if ( strcmp ( sw. alphabet, ALPHABET_RNA ) == 0 )
+	string ys ( ( char * ) y );
+	struct BestMatch bm;
+
+	/* Optional outputs gathered during the scan: the k best rotations and the distance profile */
+	struct TTopK     top;
+	struct TTopK *   topp = NULL;
+	struct TProfile  profile;
+	struct TProfile * profilep = NULL;
+	if ( sw . k > 1 )
 	{
-		alphabetLetters = RNA;
+		if ( ! topk_init ( &top, sw . k ) )	return ( 1 );
+		topp = &top;
 	}
-	else if ( strcmp ( sw. alphabet, ALPHABET_PROT ) == 0 )
+	if ( sw . profile_filename && strcmp ( method, METHOD_H ) == 0 )
 	{
-		alphabetLetters = PROT;
+		fprintf ( stderr, " Warning: hCSC does not scan every rotation; no profile will be written.\n" );
 	}
-	else
+	else if ( sw . profile_filename )
 	{
-		alphabetLetters = IUPAC;
+		unsigned int num = ( strcmp ( method, METHOD_N ) == 0 ) ? n : m;
+		if ( ! profile_open ( &profile, sw . profile_filename, num ) )	return ( 1 );
+		profilep = &profile;
 	}
-	struct BestMatch bm;
 
 	if ( strcmp ( method, METHOD_N ) == 0 )
 	{
-		nCSC ncsc ( xx, 2 * m, y, n, sw . q, sw . l, alphabetLetters );
-		ncsc . run ( &bm );
+		runQGramEngine<nCSC> ( xx, 2 * m, ys, n, sw . q, sw . l, alphabet, sw . candidates, sw . T, topp, profilep, &bm );
 		D . err = bm . score;
 		D . rot = bm . pos;
 	}
 	else if ( strcmp ( method, METHOD_H ) == 0 )
 	{
-		hCSC hcsc ( xx, 2 * m, y, n, sw . q, sw . l, alphabetLetters );
-		hcsc . run ( &bm );
+		runQGramEngine<hCSC> ( xx, 2 * m, ys, n, sw . q, sw . l, alphabet, sw . candidates, sw . T, topp, profilep, &bm );
 		D . err = bm . score;
 		D . rot = bm . pos;
 	}
 	else
 	{
-		if ( sw . P > 0 )
+		if ( sw . index_filename )
 		{
-			sacsc_refinement ( seq[0], seq[1], sw, &rotation, &distance );
+			sacsc_indexed_comparison ( &idx, y, &rotation, &distance, topp, profilep );
+		}
+		else if ( sw . P > 0 )
+		{
+			sacsc_refinement ( x, y, sw, &rotation, &distance, topp, profilep );
+		}
+		else if ( sw . anchor || sw . fft )
+		{
+			sacsc_shortlist_comparison ( x, y, sw, &rotation, &distance, topp );
+		}
+		else if ( sw . stride || sw . time_limit > 0 )
+		{
+			sacsc_coarse_to_fine ( x, y, sw, &rotation, &distance, topp );
 		}
 		else
 		{
-			circular_sequence_comparison ( seq[0], seq[1], sw, &rotation, &distance );
+			circular_sequence_comparison ( x, y, sw, &rotation, &distance, topp, profilep );
 		}
 		D . rot = rotation;
 		D . err = distance;
 	}
 
+	if ( profilep && ! profile_close ( profilep ) )	return ( 1 );
+
 	#if 0
 	for ( int i = 0; i < num_seqs; i++ )
 	{
@@ -328,7 +550,7 @@ int main(int argc, char **argv)
 		return ( 1 );
 	}
 
-	create_rotation ( seq[0], D . rot, rot_str );
+	create_rotation ( x, D . rot, rot_str );
 
 	double end = gettime();
 
@@ -337,11 +559,11 @@ int main(int argc, char **argv)
 		fprintf ( stderr, " Error: Cannot open file %s!\n", output_filename );
 		return ( 1 );
 	}
-	fprintf( out_fd, ">%s\n", seq_id[0] );
+	fprintf( out_fd, ">%s\n", x_id );
 	fprintf( out_fd, "%s\n", rot_str );
 	free ( rot_str );
-	fprintf( out_fd, ">%s\n", seq_id[1] );
-	fprintf( out_fd, "%s\n", seq[1] );
+	fprintf( out_fd, ">%s\n", y_id );
+	fprintf( out_fd, "%s\n", y );
 
 	if ( fclose ( out_fd ) )
 	{
@@ -349,29 +571,35 @@ int main(int argc, char **argv)
 		return ( 1 );
 	}
 
-        fprintf( stderr, " Seq x id is %s and its length is %d\n", seq_id[0], m );
-        fprintf( stderr, " Seq y id is %s and its length is %d\n", seq_id[1], n );
+	if ( sw . index_filename )
+        	fprintf( stderr, " Index file               : %s\n",       sw . index_filename );
+        fprintf( stderr, " Seq x id is %s and its length is %d\n", x_id, m );
+        fprintf( stderr, " Seq y id is %s and its length is %d\n", y_id, n );
+	if ( strcmp ( sw . method, METHOD_AUTO ) == 0 )
+        	fprintf( stderr, " Method chosen by planner : %s (predicted %.3g secs and %.3g MB)\n", method, plan . time[plan . chosen], plan . memory[plan . chosen] / 1048576.0 );
         fprintf( stderr, " q-gram length is %d\n",                 sw . q );
         fprintf( stderr, " Number of blocks is %d\n",              m / sw . l );
         fprintf( stderr, " Block length is %d\n",                  sw . l );
         fprintf( stderr, " Blockwise q-gram distance: %u\n",       D . err );
         fprintf( stderr, " Rotation                 : %u\n",       D . rot );
+	if ( sw . time_limit > 0 )
+        	fprintf( stderr, " Search completed         : %s (time limit %g secs)\n", deadline_expired () ? "no" : "yes", sw . time_limit );
+	if ( topp )
+	{
+		topk_sort ( topp );
+		fprintf( stderr, " Top-%u rotations        :\n",          topp -> k );
+		for ( i = 0; i < topp -> size; i++ )
+			fprintf( stderr, "  %3u. rotation %u distance %u\n", i + 1, topp -> occ[i] . rot, topp -> occ[i] . err );
+		topk_free ( topp );
+	}
+	if ( profilep )
+        	fprintf( stderr, " Distance profile file    : %s\n",       sw . profile_filename );
         fprintf( stderr, " (Multi)FASTA output file : %s\n",       sw . output_filename );
         fprintf( stderr, "Elapsed time for comparing sequences: %lf secs\n", ( end - start ) );
 
-	/* De-allocate */
-        for ( i = 0; i < num_seqs; i ++ )
-        {
-                free ( seq[i] );
-                free ( seq_id[i] );
-        }
-        free ( seq );
-        free ( seq_id );
-
-        free ( sw . input_filename );
-        free ( sw . output_filename );
-        free ( sw . alphabet );
-        free ( sw . method );
+	if ( sw . index_filename )
+		sacsc_unload_index ( &idx );
+	release ( seq, seq_id, num_seqs, &sw );
 
 	return ( 0 );
 }
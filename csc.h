@@ -19,12 +19,18 @@
 #ifndef __CSC__
 #define __CSC__
 
+#include <stdio.h>
+#include <stdlib.h>
+#include "period.h"
+
 #define ALLOC_SIZE              1048576
 #define DEL                     '$'
 #define DEL_STR                 "$"
 #define METHOD_H                "hCSC"
 #define METHOD_N                "nCSC"
 #define METHOD_SA               "saCSC"
+#define METHOD_AUTO             "auto"
+#define STRIDE_AUTO             0xFFFFFFFFU                     //-S 0: the stride is chosen from m and b
 #define ALPHABET_DNA            "DNA"
 #define ALPHABET_RNA            "RNA"
 #define ALPHABET_PROT           "PROT"
@@ -48,6 +54,28 @@ struct TSwitch
     double               P;                      // (optional) number of blocks to refine by
     double               O;
     double               E;
+    unsigned int         k;                      // number of best rotations to report
+    char *               profile_filename;       // (optional) distance profile output file name
+    unsigned int *       qs;                     // the q-gram sizes to sweep over
+    unsigned int         nq;                     // the number of q-gram sizes
+    unsigned int *       ls;                     // the block lengths to sweep over
+    unsigned int         nl;                     // the number of block lengths
+    unsigned int         T;                      // the number of threads
+    char *               build_index_filename;   // (optional) index file to build for the reference
+    char *               index_filename;         // (optional) index file of the reference to compare against
+    char *               pack_filename;          // (optional) packed sequence file to convert the input into
+    unsigned int         batch;                  // compare the consecutive pairs of the input in a pipeline
+    unsigned int         all_vs_all;             // compare every ordered pair of input sequences
+    unsigned int         both;                   // compare x against y and y against x
+    unsigned int         multi;                  // compare x against the other sequences in groups of this size
+    char *               pairs_filename;         // (optional) file of the pairs of input sequence ids to compare
+    unsigned int         anchor;                 // (optional) length of the exact-match anchors that vote for rotations
+    unsigned int         fft;                    // (optional) number of rotations to shortlist by FFT cross-correlation
+    unsigned int         stride;                 // (optional) stride of the coarse rotations of the coarse-to-fine search
+    unsigned int         candidates;             // number of gaps between coarse rotations to scan at every rotation
+    double               time_limit;             // (optional) seconds after which the search stops with its best so far
+    double               memory_limit;           // (optional) MB the engine chosen by -m auto may use
+    unsigned int         heuristic;              // whether -m auto may choose the heuristic hCSC
 };
 
 struct TPOcc
@@ -56,16 +84,62 @@ struct TPOcc
     unsigned int         rot;
 };
 
+struct TTopK
+{
+    TPOcc *              occ;                    // max-heap of the k best rotations seen so far
+    unsigned int         k;                      // capacity of the heap
+    unsigned int         size;                   // number of rotations in the heap
+    unsigned int *       slot;                   // hash table of the kept rotations: their heap index + 1, or 0
+    unsigned int         bits;                   // the hash table has 2^bits cells
+};
+
+struct TProfile
+{
+    FILE *               fd;                     // the profile file descriptor
+    unsigned int         err;                    // distance of the current run
+    unsigned int         run;                    // length of the current run
+};
+
+#define PLAN_SA                 0
+#define PLAN_N                  1
+#define PLAN_H                  2
+#define PLAN_ENGINES            3
+
+struct TPlan
+{
+    double               time[PLAN_ENGINES];     // predicted seconds of saCSC, nCSC and hCSC
+    double               memory[PLAN_ENGINES];   // predicted bytes of saCSC, nCSC and hCSC
+    unsigned int         allowed[PLAN_ENGINES];  // whether the engine meets the accuracy requirement
+    unsigned int         fits;                   // whether the chosen engine fits the memory limit
+    int                  chosen;                 // the chosen engine
+};
+
 extern int EDNA[];
 extern int BLOSUM[];
 
 double gettime( void );
+void deadline_start ( double seconds );
+unsigned int deadline_passed ( void );
+unsigned int deadline_expired ( void );
+int read_fasta ( char * input_filename, char * alphabet, unsigned char *** seq, unsigned char *** seq_id, unsigned int * num_seqs );
+int read_packed ( char * input_filename, char * alphabet, unsigned int max_seqs, unsigned char *** seq, unsigned char *** seq_id, unsigned int * num_seqs, unsigned int * total_seqs );
 int decode_switches ( int argc, char * argv [], struct TSwitch * sw );
 void usage ( void );
+unsigned int least_rotation ( unsigned char * x, unsigned int m );
 void create_rotation ( unsigned char * x, unsigned int offset, unsigned char * rotation );
 void create_backward_rotation ( unsigned char * x, unsigned int offset, unsigned char * rotation );
 int refine ( unsigned char * x, unsigned int m, unsigned char * y, unsigned int n, double p, char * alphabet );
 void init_substitution_score_tables ();
 double delta ( char a, char b, char * alphabet );
+int topk_init ( struct TTopK * top, unsigned int k );
+void topk_push ( struct TTopK * top, unsigned int err, unsigned int rot );
+void topk_sort ( struct TTopK * top );
+void topk_free ( struct TTopK * top );
+int profile_open ( struct TProfile * profile, char * filename, unsigned int num );
+void profile_push ( struct TProfile * profile, unsigned int err );
+int profile_close ( struct TProfile * profile );
+int batch_comparison ( struct TSwitch sw, char * method, char * alphabet );
+void plan_costs ( unsigned int m, unsigned int n, struct TSwitch sw, unsigned int sigma, struct TPlan * plan );
+char * plan_method ( unsigned int m, unsigned int n, struct TSwitch sw, unsigned int sigma, struct TPlan * plan );
 
 #endif
@@ -133,7 +133,10 @@ unsigned int cyc_nw_ls ( unsigned char * x, unsigned int m, unsigned char * y, u
 	    return EXIT_FAILURE;
 	}
 
-	for ( r = 0; r < n; r++ )
+	//rotations r and r + p of y are equal, so only the first p are aligned
+	int p = circular_period ( y, n );
+
+	for ( r = 0; r < p; r++ )
 	{
 		yr[0] = '\0';
 
@@ -334,55 +337,36 @@ double gettime( void )
 };
 
 /**
- * Main
+ * Reads the (Multi)FASTA file in memory
+ * @param input_filename
+ * @param seq_out the sequences
+ * @param seq_id_out the sequence ids
+ * @param num_seqs_out the number of sequences
+ * @return 1 on success
  */
-int main(int argc, char **argv)
+int read_fasta ( char * input_filename, unsigned char *** seq_out, unsigned char *** seq_id_out, unsigned int * num_seqs_out )
 {
-
-	struct TSwitch  sw;
-
-	FILE *           in_fd;                  // the input file descriptor
-	FILE *           out_fd;                 // the input file descriptor
-        char *           input_filename;         // the input file name
-        char *           output_filename;        // the output file name
+        FILE *           in_fd;                  // the input file descriptor
         unsigned char ** seq    = NULL;          // the sequence in memory
         unsigned char ** seq_id = NULL;          // the sequence id in memory
-        double           open_gap_penalty;       // open gap penalty
-	double           extend_gap_penalty;     // extend gap penalty
-	unsigned int     num_args;
-
-	num_args = decode_switches ( argc, argv, &sw );
-
-	if ( num_args < 4 ) {
-	    usage();
-	    return EXIT_FAILURE;
-	} else {
-		open_gap_penalty        = sw . open_gap_penalty;
-		extend_gap_penalty      = sw . extend_gap_penalty;
-                input_filename          = sw . input_filename;
-                output_filename         = sw . output_filename;
-	}
-
-        /* Read the (Multi)FASTA file in memory */
-        fprintf ( stderr, " Reading the (Multi)FASTA input file: %s\n", input_filename );
-        if ( ! ( in_fd = fopen ( input_filename, "r") ) )
-        {
-                fprintf ( stderr, " Error: Cannot open file %s!\n", input_filename );
-                return ( 1 );
-        }
-
         char c;
         unsigned int num_seqs = 0;           	// the total number of sequences considered
         unsigned int total_length = 0;          // the total number of sequences considered
         unsigned int max_alloc_seq_id = 0;
         unsigned int max_alloc_seq = 0;
+
+        if ( ! ( in_fd = fopen ( input_filename, "r") ) )
+        {
+                fprintf ( stderr, " Error: Cannot open file %s!\n", input_filename );
+                return ( 0 );
+        }
         c = fgetc( in_fd );
         do
         {
                 if ( c != '>' )
                 {
                         fprintf ( stderr, " Error: input file %s is not in FASTA format!\n", input_filename );
-                        return ( 1 );
+                        return ( 0 );
                 }
                 else
                 {
@@ -445,7 +429,7 @@ int main(int argc, char **argv)
                         else
                         {
                                 fprintf ( stderr, " Error: input file %s contains an unexpected character %c!\n", input_filename, c );
-                                return ( 1 );
+                                return ( 0 );
                         }
                 }
 
@@ -466,12 +450,113 @@ int main(int argc, char **argv)
 	if ( fclose ( in_fd ) )
 	{
 		fprintf( stderr, " Error: file close error!\n");
-		return ( 1 );
+		return ( 0 );
 	}
 
-	if ( num_seqs > 2 )
+        ( * seq_out )      = seq;
+        ( * seq_id_out )   = seq_id;
+        ( * num_seqs_out ) = num_seqs;
+        return ( 1 );
+}
+
+/**
+ * Reads the first two sequences of a packed sequence file in memory; only those are decoded
+ * @param input_filename
+ * @param seq_out the sequences
+ * @param seq_id_out the sequence ids
+ * @param num_seqs_out the number of sequences in memory
+ * @param total_seqs_out the number of sequences in the file
+ * @return 1 on success
+ */
+int read_packed ( char * input_filename, unsigned char *** seq_out, unsigned char *** seq_id_out, unsigned int * num_seqs_out, unsigned int * total_seqs_out )
+{
+	struct TPack p;
+
+	if ( ! pack_open ( input_filename, &p ) )
+		return ( 0 );
+
+	unsigned int num_seqs = min ( pack_num_seqs ( &p ), ( uint64_t ) 2 );
+	unsigned char ** seq = ( unsigned char ** ) calloc ( 2, sizeof ( unsigned char * ) );
+	unsigned char ** seq_id = ( unsigned char ** ) calloc ( 2, sizeof ( unsigned char * ) );
+
+	for ( unsigned int i = 0; i < num_seqs; i++ )
+	{
+		uint64_t len = pack_length ( &p, i );
+		char * id = pack_id ( &p, i );
+
+		seq[i] = ( unsigned char * ) malloc ( ( len + 1 ) * sizeof ( unsigned char ) );
+		seq_id[i] = ( unsigned char * ) malloc ( ( strlen ( id ) + 1 ) * sizeof ( unsigned char ) );
+		strcpy ( ( char * ) seq_id[i], id );
+		pack_decode ( &p, i, seq[i] );
+
+		for ( uint64_t j = 0; j < len; j++ )
+		{
+			if ( ! strchr ( ALPHABET, seq[i][j] ) )
+			{
+				fprintf ( stderr, " Error: input file %s contains an unexpected character %c!\n", input_filename, seq[i][j] );
+				return ( 0 );
+			}
+		}
+	}
+
+	( * seq_out )      = seq;
+	( * seq_id_out )   = seq_id;
+	( * num_seqs_out )   = num_seqs;
+	( * total_seqs_out ) = pack_num_seqs ( &p );
+	pack_close ( &p );
+	return ( 1 );
+}
+
+/**
+ * Main
+ */
+int main(int argc, char **argv)
+{
+
+	struct TSwitch  sw;
+
+	FILE *           out_fd;                 // the input file descriptor
+        char *           input_filename;         // the input file name
+        char *           output_filename;        // the output file name
+        unsigned char ** seq    = NULL;          // the sequence in memory
+        unsigned char ** seq_id = NULL;          // the sequence id in memory
+        double           open_gap_penalty;       // open gap penalty
+	double           extend_gap_penalty;     // extend gap penalty
+	unsigned int     num_args;
+	unsigned int     num_seqs = 0;           // the number of sequences in memory
+	unsigned int     total_seqs = 0;         // the number of sequences in the input file
+
+	num_args = decode_switches ( argc, argv, &sw );
+
+	if ( num_args < 4 ) {
+	    usage();
+	    return EXIT_FAILURE;
+	} else {
+		open_gap_penalty        = sw . open_gap_penalty;
+		extend_gap_penalty      = sw . extend_gap_penalty;
+                input_filename          = sw . input_filename;
+                output_filename         = sw . output_filename;
+	}
+
+        /* Read the (Multi)FASTA file in memory */
+        fprintf ( stderr, " Reading the (Multi)FASTA input file: %s\n", input_filename );
+        if ( pack_is_packed ( input_filename ) )
+        {
+                if ( ! read_packed ( input_filename, &seq, &seq_id, &num_seqs, &total_seqs ) )
+                        return ( 1 );
+        }
+        else if ( ! read_fasta ( input_filename, &seq, &seq_id, &num_seqs ) )
+        {
+                return ( 1 );
+        }
+        else
+        {
+                total_seqs = num_seqs;
+        }
+
+	if ( total_seqs > 2 )
 	{
-        	fprintf( stderr, " Warning: %d sequences were read from file %s.\n", num_seqs, input_filename );
+        	fprintf( stderr, " Warning: %d sequences were read from file %s.\n", total_seqs, input_filename );
         	fprintf( stderr, " Warning: Only the first two (%s, %s) will be processed!\n", seq_id[0], seq_id[1] );
 	}
 
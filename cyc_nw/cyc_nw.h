@@ -32,6 +32,8 @@
 #include <getopt.h>
 #include <assert.h>
 #include "EDNAFULL.h"
+#include "seqpack.h"
+#include "period.h"
 
 #define ALLOC_SIZE              1048576
 #define ALPHABET                "ATGCN"
@@ -62,6 +64,8 @@ unsigned int cyc_nw_ls ( unsigned char * x, unsigned int m, unsigned char * y, u
 int decode_switches ( int argc, char * argv [], struct TSwitch * sw );
 void usage ( void );
 double gettime( void );
+int read_fasta ( char * input_filename, unsigned char *** seq, unsigned char *** seq_id, unsigned int * num_seqs );
+int read_packed ( char * input_filename, unsigned char *** seq, unsigned char *** seq_id, unsigned int * num_seqs, unsigned int * total_seqs );
 
 #endif
 
@@ -24,61 +24,118 @@
 
 /**
   * Compares the xx string q-gram signature against y's q-grams and returns
-  * the starting block of xx with the best score
+  * the starting blocks of xx with the candidates best scores, best first.
+  *
+  * Every candidate start first gets a cheap lower bound: the exact distance
+  * of a sample of its block pairs plus the difference in q-gram totals of
+  * the others. The candidates are then scored in increasing order of their
+  * bound and a score is abandoned as soon as its partial sum, bounded the
+  * same way, passes the worst score kept so far (or the k-th best with -k),
+  * so good candidates are found early and most others are cut off quickly.
   * 
-  * @param XX q-grams block matrix
-  * @param Y q-grams block matrix
+  * @param XX q-gram block profiles of xx
+  * @param Y q-gram block profiles of y
   * @return
   */
-struct BestMatch hCSC::getBestScoringBlock(vector<unordered_map<WORD, unsigned int>> XX, vector<unordered_map<WORD, unsigned int>> Y)
+template <class E>
+vector<struct BestMatch> hCSC<E>::getBestScoringBlocks(const TQGramProfiles & XX, const TQGramProfiles & Y)
 {
     unsigned int numBlocks = 1 + this->bxNum - this->byNum;
-    unsigned int score, tempScore, bestScoreIndex, lowestScore = UINT_MAX;
-    unsigned int i = 0, j, k;
+    unsigned int score, bound, cutoff;
+    unsigned int i, j, k;
 
-    unordered_map<WORD, int> x;
-    x.reserve(this->qyNum + this->qxNum);
+    //the best blocks so far, ordered by score and then by block
+    vector<struct BestMatch> best;
 
-    //loop through blocks
-    do {
+    //the q-gram totals of the blocks bound the distance of a block pair from below
+    vector<unsigned int> totalX(this->bxNum, 0), totalY(this->byNum, 0);
+    for (i = 0; i < this->bxNum; i++) {
+	for (j = XX.start[i]; j < XX.start[i + 1]; j++) {
+	    totalX[i] += XX.counts[j];
+	}
+    }
+    for (i = 0; i < this->byNum; i++) {
+	for (j = Y.start[i]; j < Y.start[i + 1]; j++) {
+	    totalY[i] += Y.counts[j];
+	}
+    }
 
-	//find best score
-	score = 0;
-	for (j = i, k = 0; k < this->byNum; j++, k++) {
-	    tempScore = 0;
+    //every sampleStep-th block pair is scored exactly in the lower bound
+    unsigned int sampleStep = max(1u, (unsigned int) sqrt((double) this->byNum));
 
-	    //get qgrams scores for y block
-	    for (auto py = Y[k].begin(); py != Y[k].end(); py++) {
-		tempScore += abs(this->findInMap(XX[j], py->first) - this->findInMap(Y[k], py->first));
-		x[py->first] = -1;
-	    }
+    //blocks starting at the same position modulo the period of x are equal rotations
+    vector<bool> seen(this->period, false);
 
-	    //get qgrams scores for x block
-	    for (auto px = XX[j].begin(); px != XX[j].end(); px++) {
-		if (this->findInMap(x, px->first) != -1) {
-		    tempScore += abs(this->findInMap(XX[j], px->first) - this->findInMap(Y[k], px->first));
-		}
+    //the lower bound of every distinct candidate start
+    vector<pair<unsigned int, unsigned int>> candidates;
+    vector<unsigned int> sampled(numBlocks, 0);
+    for (i = 0; i < numBlocks; i++) {
+	if (seen[(this->bxSize * i) % this->period]) {
+	    continue;
+	}
+	seen[(this->bxSize * i) % this->period] = true;
+
+	bound = 0;
+	for (j = i, k = 0; k < this->byNum; j++, k++) {
+	    if (k % sampleStep == 0) {
+		sampled[i] += this->blockDistance(XX, j, Y, k);
+	    } else {
+		bound += abs((int) totalX[j] - (int) totalY[k]);
 	    }
+	}
+	candidates.push_back(make_pair(sampled[i] + bound, i));
+    }
+    sort(candidates.begin(), candidates.end());
 
-	    score += tempScore;
+    //score the candidates, most promising first
+    for (auto c = candidates.begin(); c != candidates.end(); c++) {
+	//stop with the best so far once the deadline has passed
+	if (c != candidates.begin() && deadline_passed()) {
+	    break;
+	}
 
-	    x.clear();
+	//a candidate must not exceed the worst score kept, or the k-th best score once k are known
+	cutoff = (best.size() < this->candidates) ? UINT_MAX : best.back().score;
+	if (this->top && this->top->size < this->top->k) {
+	    cutoff = UINT_MAX;
+	} else if (this->top) {
+	    cutoff = max(cutoff, this->top->occ[0].err);
+	}
+	if (c->first > cutoff) {
+	    break;
 	}
 
-	//record best score
-	if (score < lowestScore) {
-	    lowestScore = score;
-	    bestScoreIndex = i;
+	i = c->second;
+	score = sampled[i];
+	bound = c->first;
+	for (j = i, k = 0; k < this->byNum && bound <= cutoff; j++, k++) {
+	    if (k % sampleStep != 0) {
+		unsigned int d = this->blockDistance(XX, j, Y, k);
+		score += d;
+		bound += d - abs((int) totalX[j] - (int) totalY[k]);
+	    }
+	}
+	if (bound > cutoff) {
+	    continue;
 	}
 
-	i++;
-    }
-    while (i < numBlocks);
+	if (this->top) {
+	    topk_push(this->top, score, (this->bxSize * i) % (this->m / 2));
+	}
 
-    struct BestMatch best;
-    best.index = bestScoreIndex; //block number starting from 0
-    best.score = lowestScore;
-    best.pos = this->bxSize * bestScoreIndex; //index on xx where the block starts
+	//keep the best scores, the earliest block on ties
+	for (k = best.size(); k > 0 && (score < best[k - 1].score || (score == best[k - 1].score && i < best[k - 1].index)); k--);
+	if (k < this->candidates) {
+	    struct BestMatch match;
+	    match.index = i; //block number starting from 0
+	    match.score = score;
+	    match.pos = this->bxSize * i; //index on xx where the block starts
+	    best.insert(best.begin() + k, match);
+	    if (best.size() > this->candidates) {
+		best.pop_back();
+	    }
+	}
+    }
 
     return best;
 }
@@ -97,7 +154,8 @@ struct BestMatch hCSC::getBestScoringBlock(vector<unordered_map<WORD, unsigned i
   * @param Y The qgram vector of y
   * @return
   */
-struct BestMatch hCSC::refine(struct BestMatch oldBest, vector<unordered_map<WORD, unsigned int>> XX, vector<unordered_map<WORD, unsigned int>> Y)
+template <class E>
+struct BestMatch hCSC<E>::refine(struct BestMatch oldBest, vector<TQGramBlock> XX, vector<TQGramBlock> Y)
 {
     unsigned int i, j, k, h = 0;
     unsigned int startPos, tempStartPos;
@@ -105,15 +163,17 @@ struct BestMatch hCSC::refine(struct BestMatch oldBest, vector<unordered_map<WOR
     unsigned int score, tempScore;
     unsigned int bestScore = UINT_MAX;
     unsigned int bestTPos = oldBest.pos;
-    unordered_map<WORD, unsigned int> middleBlock;
+    TQGramBlock middleBlock;
     bool jump = false;
 
-    unordered_map<WORD, int> x;
+    TQGramMarks x;
     x.reserve(this->qyNum + this->qxNum);
 
     unsigned int qgStartPos, qgEndPos;
-    string qgStartGram, qgEndGram;
-    WORD qgStartWord, qgEndWord;
+    TKey qgStartWord, qgEndWord;
+
+    //the encoder is stateful, so every refinement keys its q-grams with its own
+    E encoder(this->qSize);
 
     if (oldBest.index == 0) {
 	startBlock = 0; 
@@ -131,6 +191,11 @@ struct BestMatch hCSC::refine(struct BestMatch oldBest, vector<unordered_map<WOR
     }
 
     do {
+	//stop with the best so far once the deadline has passed
+	if (h > 0 && deadline_passed()) {
+	    break;
+	}
+
 	//remove qgram left of the block and add q-grams right of the block with every window frame progression @todo Check if this can be refined further
 	if (startPos > 0) {
 	    tempStartBlock = startBlock;
@@ -139,19 +204,18 @@ struct BestMatch hCSC::refine(struct BestMatch oldBest, vector<unordered_map<WOR
 	    for (i = 0; i < this->byNum; i++) {
 
 		qgEndPos = tempStartPos + this->bxSize;
-		if (qgEndPos > this->m) {
+		//the q-gram added at qgEndPos must lie within xx
+		if (qgEndPos + this->qSize > this->m) {
 		    break;
 		} else {
 		    qgStartPos = tempStartPos;
-		    qgStartGram = this->xx.substr(qgStartPos, this->qSize);
-		    qgStartWord = this->shuffleOntoWord(qgStartGram);
+		    qgStartWord = encoder.encode(this->xx.data() + qgStartPos);
 		    XX[tempStartBlock][qgStartWord]--;
 		    if (XX[tempStartBlock][qgStartWord] == 0) {
 			XX[tempStartBlock].erase(qgStartWord);
 		    }
 
-		    qgEndGram = this->xx.substr(qgEndPos, this->qSize);
-		    qgEndWord = this->shuffleOntoWord(qgEndGram);
+		    qgEndWord = encoder.encode(this->xx.data() + qgEndPos);
 		    XX[tempStartBlock][qgEndWord]++;
 		}
 
@@ -183,6 +247,11 @@ struct BestMatch hCSC::refine(struct BestMatch oldBest, vector<unordered_map<WOR
 	    x.clear();
 	}
 
+	if (this->top) {
+	    lock_guard<mutex> lock(this->topLock);
+	    topk_push(this->top, score, startPos % (this->m / 2));
+	}
+
 	//record best score
 	if (score < bestScore) {
 	    bestScore = score;
@@ -202,6 +271,11 @@ struct BestMatch hCSC::refine(struct BestMatch oldBest, vector<unordered_map<WOR
     }
     while (h < (2 * this->bxSize - 2) && (startPos + this->n) <= this->m);
 
+    //a refinement cut short by the deadline may not reach the block scan's best
+    if (bestScore > oldBest.score) {
+	return oldBest;
+    }
+
     struct BestMatch best;
     best.index = (int)(bestTPos / this->bxSize); //block index starting from 0
     best.score = bestScore; //score
@@ -219,7 +293,8 @@ struct BestMatch hCSC::refine(struct BestMatch oldBest, vector<unordered_map<WOR
   * 
   * @param best The best match
   */
-int hCSC::run(struct BestMatch * best)
+template <class E>
+int hCSC<E>::run(struct BestMatch * best)
 {
     //check block and q length
     if (this->qSize >= min(this->bxSize, this->bySize)) {
@@ -228,34 +303,65 @@ int hCSC::run(struct BestMatch * best)
     }
 
     //check there isn't any q-gram overflow
-    if ((this->qSize * this->l) > WORD_SIZE) {
+    if (this->qSize > E::maxQ) {
 	cerr << "An error occured. Q-gram overflow exception. Please choose a smaller q-gram size." << endl;
 	return EXIT_FAILURE;
     }
 
-    //create XX and Y matrices
-    vector<unordered_map<WORD, unsigned int>> XX;
-    vector<unordered_map<WORD, unsigned int>> Y;
-    XX.resize(this->bxNum);
-    Y.resize(this->byNum);
+    //create and fill XX and Y matrices
+    vector<TQGramBlock> XX;
+    vector<TQGramBlock> Y;
     unsigned int i;
-    for (i = 0; i < this->bxNum; i++) {
-	XX[i].reserve(this->qxNum);
-    }
-    for (i = 0; i < this->byNum; i++) {
-	Y[i].reserve(this->qyNum);
+    this->fillQGramProfiles(XX, Y);
+
+    //compare XX q-gram signature against Y q-grams to find the best matches
+    vector<struct BestMatch> candidates = this->getBestScoringBlocks(this->sortQGramBlocks(XX), this->sortQGramBlocks(Y));
+    //cout << "Heuristic best score, index and position " << candidates[0].score << " " << candidates[0].index << " " << candidates[0].pos << endl;
+
+    //refine every candidate, unless the deadline passed during the block scan; each refinement works on its own copy of XX
+    vector<struct BestMatch> refined(candidates);
+    if (!deadline_passed()) {
+	atomic<unsigned int> next(0);
+	auto worker = [&]() {
+	    unsigned int c;
+	    while ((c = next++) < candidates.size()) {
+		if (c > 0 && deadline_passed()) {
+		    break;
+		}
+		refined[c] = this->refine(candidates[c], XX, Y);
+	    }
+	};
+	vector<thread> pool;
+	for (i = 1; i < min(this->threads, (unsigned int) candidates.size()); i++) {
+	    pool.push_back(thread(worker));
+	}
+	worker();
+	for (auto & t : pool) {
+	    t.join();
+	}
     }
 
-    XX = fillQGramBlocks(XX, this->xx, this->m, this->bxSize, this->qxNum);
-    Y = fillQGramBlocks(Y, this->y, this->n, this->bySize, this->qyNum);
-
-    //compare XX q-gram signature against Y q-grams to find best match
-    struct BestMatch bestSoFar = this->getBestScoringBlock(XX, Y);
-    //cout << "Heuristic best score, index and position " << bestSoFar.score << " " << bestSoFar.index << " " << bestSoFar.pos << endl;
-
-    //get refinement
-    ( * best ) = this->refine(bestSoFar, XX, Y);
-    //cout << "Refined best position and score - " << best.pos << ", " << best.score << " - " << this->xx.substr(best.pos, this->n) << endl;
+    //the global best, the best ranked candidate on ties
+    ( * best ) = refined[0];
+    for (i = 1; i < refined.size(); i++) {
+	if (refined[i].score < best->score) {
+	    ( * best ) = refined[i];
+	}
+    }
+    //cout << "Refined best position and score - " << best->pos << ", " << best->score << " - " << this->xx.substr(best->pos, this->n) << endl;
 
     return EXIT_SUCCESS;
 }
+
+template class hCSC<TQGramEncoder<TDNAAlphabet, WORD>>;
+template class hCSC<TQGramEncoder<TDNAAlphabet, WIDE_WORD>>;
+template class hCSC<TQGramHasher<TDNAAlphabet>>;
+template class hCSC<TQGramEncoder<TRNAAlphabet, WORD>>;
+template class hCSC<TQGramEncoder<TRNAAlphabet, WIDE_WORD>>;
+template class hCSC<TQGramHasher<TRNAAlphabet>>;
+template class hCSC<TQGramEncoder<TIUPACAlphabet, WORD>>;
+template class hCSC<TQGramEncoder<TIUPACAlphabet, WIDE_WORD>>;
+template class hCSC<TQGramHasher<TIUPACAlphabet>>;
+template class hCSC<TQGramEncoder<TProteinAlphabet, WORD>>;
+template class hCSC<TQGramEncoder<TProteinAlphabet, WIDE_WORD>>;
+template class hCSC<TQGramHasher<TProteinAlphabet>>;
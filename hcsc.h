@@ -19,19 +19,35 @@
 #ifndef __HCSC_H_INCLUDED__
 #define __HCSC_H_INCLUDED__
 
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include "qcsc.h"
 
 /**
  * hCSC: A heuristic q-gram based approximate pairwise circular sequence alignment algorithm
+ *
+ * @tparam E The q-gram encoder
  */
-class hCSC : public qCSC
+template <class E>
+class hCSC : public qCSC<E>
 {
 private:
-    struct BestMatch getBestScoringBlock(vector<unordered_map<WORD, unsigned int>> XX, vector<unordered_map<WORD, unsigned int>> Y);
-    struct BestMatch refine(struct BestMatch oldBest, vector<unordered_map<WORD, unsigned int>> XX, vector<unordered_map<WORD, unsigned int>> Y);
+    typedef typename qCSC<E>::TKey TKey;
+    typedef typename qCSC<E>::TQGramBlock TQGramBlock;
+    typedef typename qCSC<E>::TQGramMarks TQGramMarks;
+    typedef typename qCSC<E>::TQGramProfiles TQGramProfiles;
+
+    /**
+     * @var topLock Serialises the refining threads' offers to the top-k heap
+     */
+    mutex topLock;
+
+    vector<struct BestMatch> getBestScoringBlocks(const TQGramProfiles & XX, const TQGramProfiles & Y);
+    struct BestMatch refine(struct BestMatch oldBest, vector<TQGramBlock> XX, vector<TQGramBlock> Y);
 
 public:
-    hCSC(string xx, unsigned int m, string y, unsigned int n, unsigned int q, unsigned int b, string a) : qCSC(xx, m, y, n, q, b, a){}
+    hCSC(string xx, unsigned int m, string y, unsigned int n, unsigned int q, unsigned int b) : qCSC<E>(xx, m, y, n, q, b){}
     int run(struct BestMatch * best);
 };
 
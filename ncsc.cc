@@ -29,22 +29,29 @@
   * @param Y The qgram vector of y
   * @return The best position of y in xx
   */
-struct BestMatch nCSC::runNaive(vector<unordered_map<WORD, unsigned int>> XX, vector<unordered_map<WORD, unsigned int>> Y)
+template <class E>
+struct BestMatch nCSC<E>::runNaive(vector<TQGramBlock> XX, vector<TQGramBlock> Y)
 {
     unsigned int i, j;
     unsigned int startPos = 0, startBlock = 0;
     unsigned int tempStartPos, tempStartBlock;
     unsigned int score, tempScore;
     unsigned int bestScore = UINT_MAX, bestTPos;
+    unsigned int numPos = min(this->n, this->period);
+    vector<unsigned int> scores;
 
-    unordered_map<WORD, int> x;
+    TQGramMarks x;
     x.reserve(this->qyNum + this->qxNum);
 
     unsigned int qgStartPos, qgEndPos;
-    string qgStartGram, qgEndGram;
-    WORD qgStartWord, qgEndWord;
+    TKey qgStartWord, qgEndWord;
 
     do {
+	//stop with the best so far once the deadline has passed
+	if (startPos > 0 && deadline_passed()) {
+	    break;
+	}
+
 	//remove qgram left of the block and add q-grams right of the block with every window frame progression
 	if (startPos > 0) {
 	    tempStartBlock = startBlock;
@@ -53,19 +60,18 @@ struct BestMatch nCSC::runNaive(vector<unordered_map<WORD, unsigned int>> XX, ve
 	    for (i = 0; i < this->byNum; i++) {
 
 		qgEndPos = tempStartPos + this->bxSize;
-		if (qgEndPos > this->m) {
+		//the q-gram added at qgEndPos must lie within xx
+		if (qgEndPos + this->qSize > this->m) {
 		    break;
 		} else {
 		    qgStartPos = tempStartPos;
-		    qgStartGram = this->xx.substr(qgStartPos, this->qSize);
-		    qgStartWord = this->shuffleOntoWord(qgStartGram);
+		    qgStartWord = this->encodeAt(this->xx, qgStartPos);
 		    XX[tempStartBlock][qgStartWord]--;
 		    if (XX[tempStartBlock][qgStartWord] == 0) {
 			XX[tempStartBlock].erase(qgStartWord);
 		    }
 
-		    qgEndGram = this->xx.substr(qgEndPos, this->qSize);
-		    qgEndWord = this->shuffleOntoWord(qgEndGram);
+		    qgEndWord = this->encodeAt(this->xx, qgEndPos);
 		    XX[tempStartBlock][qgEndWord]++;
 		}
 
@@ -97,6 +103,12 @@ struct BestMatch nCSC::runNaive(vector<unordered_map<WORD, unsigned int>> XX, ve
 	    x.clear();
 	}
 
+	if (numPos < this->n && (this->top || this->profile)) {
+	    scores.push_back(score);
+	} else {
+	    this->record(score, startPos);
+	}
+
 	//record best score
 	if (score < bestScore) {
 	    bestScore = score;
@@ -106,7 +118,16 @@ struct BestMatch nCSC::runNaive(vector<unordered_map<WORD, unsigned int>> XX, ve
 	//move window along one and update block number
 	startPos++;
     }
-    while (startPos < this->n);
+    while (startPos < numPos);
+
+    //the windows past the period of x repeat the scores of the first period
+    if (!scores.empty()) {
+	for (i = 0; i < this->n; i++) {
+	    if (i % numPos < scores.size()) {
+		this->record(scores[i % numPos], i);
+	    }
+	}
+    }
 
     struct BestMatch best;
     best.index = (int)(bestTPos / this->bxSize); //block index starting from 0
@@ -125,7 +146,8 @@ struct BestMatch nCSC::runNaive(vector<unordered_map<WORD, unsigned int>> XX, ve
   * 
   * @param best The best match
   */
-int nCSC::run(struct BestMatch * best)
+template <class E>
+int nCSC<E>::run(struct BestMatch * best)
 {
     //check block and q length
     if (this->qSize >= min(this->bxSize, this->bySize)) {
@@ -134,26 +156,15 @@ int nCSC::run(struct BestMatch * best)
     }
 
     //check there isn't any q-gram overflow
-    if ((this->qSize * this->l) > WORD_SIZE) {
+    if (this->qSize > E::maxQ) {
 	cerr << "An error occured. Q-gram overflow exception. Please choose a smaller q-gram size." << endl;
 	return EXIT_FAILURE;
     }
 
-    //create XX and Y matrices
-    vector<unordered_map<WORD, unsigned int>> XX;
-    vector<unordered_map<WORD, unsigned int>> Y;
-    XX.resize(this->bxNum);
-    Y.resize(this->byNum);
-    unsigned int i;
-    for (i = 0; i < this->bxNum; i++) {
-	XX[i].reserve(this->qxNum);
-    }
-    for (i = 0; i < this->byNum; i++) {
-	Y[i].reserve(this->qyNum);
-    }
-
-    XX = fillQGramBlocks(XX, this->xx, this->m, this->bxSize, this->qxNum);
-    Y = fillQGramBlocks(Y, this->y, this->n, this->bySize, this->qyNum);
+    //create and fill XX and Y matrices
+    vector<TQGramBlock> XX;
+    vector<TQGramBlock> Y;
+    this->fillQGramProfiles(XX, Y);
 
     //print out all scores of y against x
     ( * best ) = this->runNaive(XX, Y);
@@ -161,3 +172,16 @@ int nCSC::run(struct BestMatch * best)
 
     return EXIT_SUCCESS;
 }
+
+template class nCSC<TQGramEncoder<TDNAAlphabet, WORD>>;
+template class nCSC<TQGramEncoder<TDNAAlphabet, WIDE_WORD>>;
+template class nCSC<TQGramHasher<TDNAAlphabet>>;
+template class nCSC<TQGramEncoder<TRNAAlphabet, WORD>>;
+template class nCSC<TQGramEncoder<TRNAAlphabet, WIDE_WORD>>;
+template class nCSC<TQGramHasher<TRNAAlphabet>>;
+template class nCSC<TQGramEncoder<TIUPACAlphabet, WORD>>;
+template class nCSC<TQGramEncoder<TIUPACAlphabet, WIDE_WORD>>;
+template class nCSC<TQGramHasher<TIUPACAlphabet>>;
+template class nCSC<TQGramEncoder<TProteinAlphabet, WORD>>;
+template class nCSC<TQGramEncoder<TProteinAlphabet, WIDE_WORD>>;
+template class nCSC<TQGramHasher<TProteinAlphabet>>;
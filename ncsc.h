@@ -23,14 +23,21 @@
 
 /**
  * nCSC: A naive q-gram based pairwise circular sequence alignment algorithm
+ *
+ * @tparam E The q-gram encoder
  */
-class nCSC : public qCSC
+template <class E>
+class nCSC : public qCSC<E>
 {
 private:
-    struct BestMatch runNaive(vector<unordered_map<WORD, unsigned int>> XX, vector<unordered_map<WORD, unsigned int>> Y);
+    typedef typename qCSC<E>::TKey TKey;
+    typedef typename qCSC<E>::TQGramBlock TQGramBlock;
+    typedef typename qCSC<E>::TQGramMarks TQGramMarks;
+
+    struct BestMatch runNaive(vector<TQGramBlock> XX, vector<TQGramBlock> Y);
 
 public:
-    nCSC(string xx, unsigned int m, string y, unsigned int n, unsigned int q, unsigned int b, string a) : qCSC(xx, m, y, n, q, b, a){}
+    nCSC(string xx, unsigned int m, string y, unsigned int n, unsigned int q, unsigned int b) : qCSC<E>(xx, m, y, n, q, b){}
     int run(struct BestMatch * best);
 };
 
@@ -0,0 +1,52 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef __PERIOD__
+#define __PERIOD__
+
+#include <stdlib.h>
+
+/*
+Returns the smallest circular period of s[0..m-1], that is the smallest p
+dividing m such that s is a power of s[0..p-1], from the prefix function of s.
+Rotations r and r + p of s are equal, so only the first p need to be scanned.
+*/
+template <typename T>
+unsigned int circular_period ( T * s, unsigned int m )
+{
+    unsigned int * pi;
+
+    if ( m == 0 || ( pi = ( unsigned int * ) calloc ( m, sizeof ( unsigned int ) ) ) == NULL )
+        return ( m );
+
+    for ( unsigned int i = 1; i < m; i++ )
+    {
+        unsigned int k = pi[i - 1];
+        while ( k > 0 && s[i] != s[k] )
+            k = pi[k - 1];
+        if ( s[i] == s[k] )
+            k++;
+        pi[i] = k;
+    }
+    unsigned int p = m - pi[m - 1];
+    free ( pi );
+
+    return ( m % p == 0 ) ? p : m;
+}
+
+#endif
@@ -0,0 +1,108 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "csc.h"
+#include "sacsc.h"
+
+/* Seconds per elementary step, measured on a 20 kbp DNA pair */
+#define COST_SA_SORT            1.7e-8                  // per suffix and level of the suffix sort of xxy
+#define COST_SA_SCAN            2.5e-8                  // per rotation and block of the saCSC scan
+#define COST_SA_ALIGN           5.0e-9                  // per cell of the -P refinement alignments
+#define COST_MAP                1.4e-7                  // per q-gram map lookup or update of nCSC and hCSC
+#define COST_MERGE              7.0e-9                  // per merged key of the hCSC block scan
+
+/* Bytes per stored q-gram of a node-based block map, key and count included */
+#define MAP_ENTRY_BYTES         48.0
+
+/*
+Predicts the time and memory of every engine on a pair of lengths m and n
+with the q-gram length, block length and threads of sw, over an alphabet of
+sigma letters. The number of distinct q-grams is bounded by sigma^q and by
+the text, which sizes the saCSC diff tables ( b of them ) and the q-gram
+maps of nCSC and hCSC; -P adds its ( sl )^2 alignments over sl shifts.
+*/
+void plan_costs ( unsigned int m, unsigned int n, struct TSwitch sw, unsigned int sigma, struct TPlan * plan )
+{
+	double N = 2.0 * m + n;
+	double q = sw . q;
+	double l = sw . l;
+	double b = floor ( m / l );
+	double T = ( sw . T > 1 ) ? sw . T : 1;
+	double distinct = fmin ( pow ( sigma, q ), N );
+	double inBlock = fmin ( pow ( sigma, q ), l + q - 1 );	//distinct q-grams of a block
+
+	/* saCSC: the SA and LCP of xxy, x' and y', and a diff table per block over the distinct q-grams */
+	plan -> time[PLAN_SA] = COST_SA_SORT * N * log2 ( N ) / ( T > 1 ? T / 2 : 1 ) + COST_SA_SCAN * m * b;
+	plan -> memory[PLAN_SA] = N * ( 1 + 3 * sizeof ( INT ) ) + b * ( distinct + 1 ) * sizeof ( INT );
+	if ( sw . P > 0 )
+	{
+		double sl = sw . P * l;
+		plan -> time[PLAN_SA] += COST_SA_ALIGN * sl * sl * sl;
+		plan -> memory[PLAN_SA] += sl * sl * sizeof ( int );
+	}
+
+	/* nCSC: the maps of every block of xx and y, rescored at every position of xx */
+	double entries = ( 2.0 * m / l ) * inBlock + ( n / l ) * inBlock;
+	plan -> time[PLAN_N] = COST_MAP * ( N + ( double ) m * n );
+	plan -> memory[PLAN_N] = 2 * N + entries * MAP_ENTRY_BYTES;
+
+	/* hCSC: the block scan on sorted profiles and the refinement of -C candidates on copies of the maps of xx */
+	double C = ( sw . candidates > 0 ) ? sw . candidates : 1;
+	double copies = fmin ( C, T );
+	plan -> time[PLAN_H] = COST_MAP * N / T + COST_MERGE * ( double ) m * n / l + COST_MAP * ceil ( C / T ) * 2 * l * n;
+	plan -> memory[PLAN_H] = 2 * N + entries * ( MAP_ENTRY_BYTES + sizeof ( INT ) ) + copies * ( 2.0 * m / l ) * inBlock * MAP_ENTRY_BYTES;
+}
+
+/*
+Chooses the engine for a pair of lengths m and n: the fastest predicted one
+whose memory fits sw . memory_limit ( in MB, 0 for no limit ) among the
+exact engines, saCSC and nCSC, and also hCSC when sw . heuristic allows a
+heuristic result. When none fits, the one needing the least memory is
+chosen. Returns METHOD_SA, METHOD_N or METHOD_H.
+*/
+char * plan_method ( unsigned int m, unsigned int n, struct TSwitch sw, unsigned int sigma, struct TPlan * plan )
+{
+	static const char * methods[PLAN_ENGINES] = { METHOD_SA, METHOD_N, METHOD_H };
+	double budget = sw . memory_limit * 1048576.0;
+
+	plan_costs ( m, n, sw, sigma, plan );
+
+	int best = -1;
+	int smallest = PLAN_SA;
+	for ( int e = 0; e < PLAN_ENGINES; e++ )
+	{
+		plan -> allowed[e] = ( e != PLAN_H || sw . heuristic );
+		if ( ! plan -> allowed[e] )
+			continue;
+		if ( plan -> memory[e] < plan -> memory[smallest] )
+			smallest = e;
+		if ( budget > 0 && plan -> memory[e] > budget )
+			continue;
+		if ( best < 0 || plan -> time[e] < plan -> time[best] )
+			best = e;
+	}
+	plan -> fits = ( best >= 0 );
+	plan -> chosen = plan -> fits ? best : smallest;
+
+	return ( char * ) methods[plan -> chosen];
+}
@@ -28,12 +28,12 @@
 #include <iostream>
 #include <vector>
 #include <unordered_map>
+#include <thread>
+#include "csc.h"
+#include "alphabet.h"
 
 using namespace std;
 
-typedef unsigned long int       WORD;
-#define WORD_SIZE               sizeof(WORD) * 8
-
 /**
  * A struct to hold the best matching block information -
  * the block index, score and block starting position for
@@ -45,14 +45,35 @@ struct BestMatch {
     unsigned int pos;
 };
 
+/**
+ * The q-gram profiles of a sequence of blocks in one arena: block i holds
+ * keys[start[i]] to keys[start[i + 1] - 1] in increasing order, and the
+ * count of every key at the same position of counts
+ */
+template <class K>
+struct TBlockProfiles
+{
+    vector<K> keys;
+    vector<unsigned int> counts;
+    vector<unsigned int> start;
+};
+
 /**
  * qCSC: An abstract class that is extended by hCSC and nCSC to do their q-gram based pairwise circular sequence alignment
  * 
  * @abstract
+ * @tparam E The q-gram encoder: TQGramEncoder of an alphabet policy into 64- or
+ * 128-bit keys, or TQGramHasher for q-grams too long to pack
  */
+template <class E>
 class qCSC
 {
 protected:
+    typedef typename E::key_type TKey;
+    typedef unordered_map<TKey, unsigned int, typename E::hasher> TQGramBlock;
+    typedef unordered_map<TKey, int, typename E::hasher> TQGramMarks;
+    typedef TBlockProfiles<TKey> TQGramProfiles;
+
 
     /**
      * @var sigma Alphabet size
@@ -98,114 +119,201 @@ protected:
      * @var byNum The number of blocks in y
      */
     unsigned int byNum;
-    /**
-     * @var l How many bits are required to represent a character of the Alphabet
-     */
-    unsigned int l;
     /**
      * @var qSize The size of the q-gram in characters
      */
     unsigned int qSize;
     /**
-     * @var chars Stores the decimal value of characters of the alphabet
+     * @var encoder The q-gram encoder of the alphabet
+     */
+    E encoder;
+    /**
+     * @var period The smallest circular period of x: rotations r and r + period are equal
      */
-    WORD * chars;
+    unsigned int period;
     /**
-     * @var numPerms The number of permutations possible (sigma^q)
+     * @var top (optional) Heap collecting the k best rotations seen during the scan
      */
-    unsigned int numPerms;
+    struct TTopK * top;
+    /**
+     * @var profile (optional) Run-length encoded profile of every scanned distance
+     */
+    struct TProfile * profile;
+    /**
+     * @var candidates The number of best blocks whose neighbourhood is refined
+     */
+    unsigned int candidates;
+    /**
+     * @var threads The number of threads the engine may use
+     */
+    unsigned int threads;
 
     /**
-     * Fills chars array and returns the size of the alphabet
+     * Offers a scanned position of xx to the top-k heap and the profile
      *
-     * @return Number of unique characters
+     * @param score The blockwise distance at pos
+     * @param pos The starting position on xx
      */
-    unsigned int generateCharHashmap(void)
+    void record(unsigned int score, unsigned int pos)
     {
-	char * c;
-	if ((c = (char *) calloc(CHAR_MAX, sizeof(char))) == NULL) {
-	    cerr << "Error assigning char" << endl;
-	}
-      
-	//go through xx and y and mark characters found
-	unsigned int i;
-	for (i = 0; i < this->m / 2; i++) {
-	    c[(char)this->xx[i]] = 1;
-	}
-	for (i = 0; i < this->n; i++) {
-	    c[(char)this->y[i]] = 1;
+	if (this->top) {
+	    topk_push(this->top, score, pos % (this->m / 2));
 	}
-
-	//give characters unique id
-	WORD counter = 0;
-	for (i = 0; i < CHAR_MAX; i++) {
-	    if (c[i] == 1) {
-		//cout << (char)i << counter << endl;
-		this->chars[i] = counter++;
-	    }
+	if (this->profile) {
+	    profile_push(this->profile, score);
 	}
-
-	free(c);
-
-	return (unsigned int)counter;
     }
 
     /**
-     * Turns string's characters into Q-Grams and shuffles them onto a word
-     * Warning: No word-size bounds checking
+     * Keys the q-gram of s starting at pos, which must leave q letters
      *
      * @param s A string
+     * @param pos The starting position of the q-gram, at most s.length() - q
      * @return
      */
-    WORD shuffleOntoWord(string s)
+    TKey encodeAt(const string & s, unsigned int pos)
     {
-	WORD w = 0;
-
-	unsigned int i;
-	for (i = 0; i < s.length(); i++) {
-	    w = w << this->l;
-	    w = w | this->chars[s.at(i)];
-	}
-
-	return w;
+	return this->encoder.encode(s.data() + pos);
     }
 
     /**
-     * Fills a matrix with the calculated qgrams
+     * Fills blocks first to last - 1 of a matrix with the calculated qgrams
      * 
      * @param Z The matrix to fill
      * @param s The sequence to put into the matrix
      * @param len The length of s
      * @param charsInBlock The number of characters in a block of s
      * @param qgramsInBlock The number of qGrams in a block of s
-     * @return
+     * @param first The first block to fill
+     * @param last The block past the last one to fill
+     * @param encoder The encoder keying the q-grams of this range
      */
-    vector<unordered_map<WORD, unsigned int>> fillQGramBlocks(vector<unordered_map<WORD, unsigned int>> Z, string s, unsigned int len, unsigned int charsInBlock, unsigned int qgramsInBlock)
+    void fillQGramBlocks(vector<TQGramBlock> & Z, const string & s, unsigned int len, unsigned int charsInBlock, unsigned int qgramsInBlock,
+			 unsigned int first, unsigned int last, E & encoder)
     {
-	int i, j, blkLen, blockNum = 0, qSize = (int)this->qSize;
-	WORD qGram;
+	int i, j, blkLen, qSize = (int)this->qSize;
+	unsigned int blockNum;
+	TKey qGram;
 
 	//loop through string in block-sized segments
-	for (i = 0; i < len; i += charsInBlock) {
+	for (blockNum = first; blockNum < last && blockNum * charsInBlock < len; blockNum++) {
+	    i = blockNum * charsInBlock;
 
 	    //get the current block
-	    blkLen = s.substr(i, qgramsInBlock).length();
+	    blkLen = min((int) qgramsInBlock, (int) s.length() - i);
+	    Z[blockNum].reserve(qgramsInBlock);
 
-	    //count q-grams in each block
+	    //count q-grams in each block, rolling the key along the block
 	    for (j = 0; j < blkLen - qSize + 1; j++) {
-		//read the current qGram from the block
-		qGram = shuffleOntoWord(s.substr(i + j, qSize));
+		qGram = (j == 0) ? encoder.encode(s.data() + i) : encoder.roll(s[i + j - 1], s[i + j + qSize - 1]);
 
 		//initialise q-gram count or increment if already exists
-		Z[blockNum].emplace(qGram, 0);
 		Z[blockNum][qGram]++;
 	    }
+	}
+    }
 
-	    //next block index
-	    blockNum++;
+    /**
+     * Fills the q-gram matrices of xx and y. The blocks of both are split
+     * into even runs over the threads; every block is written by one thread
+     * only and every thread keys its q-grams with its own encoder.
+     *
+     * @param XX The matrix of xx to fill
+     * @param Y The matrix of y to fill
+     */
+    void fillQGramProfiles(vector<TQGramBlock> & XX, vector<TQGramBlock> & Y)
+    {
+	unsigned int total = this->bxNum + this->byNum;
+	unsigned int threads = min(this->threads, total);
+	XX.resize(this->bxNum);
+	Y.resize(this->byNum);
+
+	auto worker = [&](unsigned int t) {
+	    E encoder(this->qSize);
+	    unsigned int first = (unsigned int) ((unsigned long) total * t / threads);
+	    unsigned int last = (unsigned int) ((unsigned long) total * (t + 1) / threads);
+	    if (first < this->bxNum) {
+		this->fillQGramBlocks(XX, this->xx, this->m, this->bxSize, this->qxNum, first, min(last, this->bxNum), encoder);
+	    }
+	    if (last > this->bxNum) {
+		this->fillQGramBlocks(Y, this->y, this->n, this->bySize, this->qyNum, max(first, this->bxNum) - this->bxNum, last - this->bxNum, encoder);
+	    }
+	};
+
+	vector<thread> pool;
+	for (unsigned int t = 1; t < threads; t++) {
+	    pool.push_back(thread(worker, t));
+	}
+	worker(0);
+	for (auto & th : pool) {
+	    th.join();
 	}
+    }
 
-	return Z;
+    /**
+     * Packs the q-gram blocks into sorted arrays in one arena
+     *
+     * @param Z The q-gram blocks
+     * @return
+     */
+    TQGramProfiles sortQGramBlocks(const vector<TQGramBlock> & Z)
+    {
+	TQGramProfiles P;
+	size_t total = 0;
+	for (auto & z : Z) {
+	    total += z.size();
+	}
+	P.keys.reserve(total);
+	P.counts.reserve(total);
+	P.start.reserve(Z.size() + 1);
+	P.start.push_back(0);
+
+	vector<pair<TKey, unsigned int>> block;
+	for (auto & z : Z) {
+	    block.assign(z.begin(), z.end());
+	    sort(block.begin(), block.end());
+	    for (auto & e : block) {
+		P.keys.push_back(e.first);
+		P.counts.push_back(e.second);
+	    }
+	    P.start.push_back(P.keys.size());
+	}
+
+	return P;
+    }
+
+    /**
+     * The L1 distance between the q-gram profiles of block i of X and block
+     * j of Y, merging their sorted keys without branching on the order
+     *
+     * @return
+     */
+    unsigned int blockDistance(const TQGramProfiles & X, unsigned int i, const TQGramProfiles & Y, unsigned int j)
+    {
+	const TKey * kx = X.keys.data();
+	const TKey * ky = Y.keys.data();
+	const unsigned int * cx = X.counts.data();
+	const unsigned int * cy = Y.counts.data();
+	unsigned int a = X.start[i], aEnd = X.start[i + 1];
+	unsigned int b = Y.start[j], bEnd = Y.start[j + 1];
+	unsigned int d = 0;
+
+	while (a < aEnd && b < bEnd) {
+	    bool lt = kx[a] < ky[b];
+	    bool gt = ky[b] < kx[a];
+	    int u = cx[a], v = cy[b];
+	    d += lt ? u : (gt ? v : abs(u - v));
+	    a += !gt;
+	    b += !lt;
+	}
+	for (; a < aEnd; a++) {
+	    d += cx[a];
+	}
+	for (; b < bEnd; b++) {
+	    d += cy[b];
+	}
+
+	return d;
     }
 
     /**
@@ -216,8 +324,8 @@ protected:
      * @param key
      * @return value stored for the given key or 0
      */
-    int findInMap(unordered_map<WORD, unsigned int> map, WORD key) {
-	unordered_map<WORD, unsigned int>::const_iterator i = map.find(key);
+    int findInMap(const TQGramBlock & map, const TKey & key) {
+	typename TQGramBlock::const_iterator i = map.find(key);
 	return (i == map.end()) ? 0 : i->second;
     }
 
@@ -229,8 +337,8 @@ protected:
      * @param key
      * @return value stored for the given key or 0
      */
-    int findInMap(unordered_map<WORD, int> map, WORD key) {
-	unordered_map<WORD, int>::const_iterator i = map.find(key);
+    int findInMap(const TQGramMarks & map, const TKey & key) {
+	typename TQGramMarks::const_iterator i = map.find(key);
 	return (i == map.end()) ? 0 : i->second;
     }
 
@@ -245,36 +353,22 @@ public:
      * @param n length of y
      * @param q q-gram length as set by the user
      * @param b block length as set by the user
-     * @param a alphabet characters as defined by the user
      * @return
      */
-    qCSC(string xx, unsigned int m, string y, unsigned int n, unsigned int q, unsigned int b, string a)
+    qCSC(string xx, unsigned int m, string y, unsigned int n, unsigned int q, unsigned int b) : encoder(q)
     {
 	this->xx = xx;
 	this->m = m;
 	this->y = y;
 	this->n = n;
+	this->top = NULL;
+	this->profile = NULL;
+	this->candidates = 1;
+	this->threads = 1;
+	this->period = circular_period(this->xx.c_str(), this->m / 2);
 	
-	//initialise the chars array - faster than hashmap look-up but takes up a little bit more memory
-	//if ((this->chars = (WORD *) calloc(CHAR_MAX, sizeof(WORD))) == NULL) {
-	//    cerr << "Could not allocate the chars map." << endl;
-	//}
-
-	//sigma holds the size of the alphabet, chars the characters
-	if (a.length() == 0) {
-	    this->sigma = this->generateCharHashmap();
-	} else {
-	    this->sigma = a.length();
-	    WORD i;
-	    for (i = 0; i < this->sigma; i++) {
-		this->chars[a[i]] = i;
-	    }
-	}
-	//cout << "sigma: " << this->sigma << endl;
-
-	//l holds the size of a single letter in the q-gram in bits; If sigma is 4, l is 2 (00,01,10,11)
-	this->l = (unsigned int) ceil(sqrt(this->sigma));
-	//cout << "l: " << this->l << endl;
+	//sigma holds the size of the alphabet, escaping letters included
+	this->sigma = strlen(E::alphabet::letters());
 
 	//qSize holds the q-gram size
 	if (q == 0) {
@@ -290,9 +384,7 @@ public:
 	}
 	//cout << "Q-Gram size: " << this->qSize << endl;
 
-	//numPerms is the number of q-sized permutations that can be made from the alphabet
-	this->numPerms = (unsigned int) pow((double)this->sigma, (double)this->qSize);
-	//cout << "perms: " << this->numPerms << endl;
+	this->encoder = E(this->qSize);
 
 	//how many characters in an xx block
 	if (b == 0) {
@@ -327,12 +419,32 @@ public:
 	//cout << "blocks y: " << this->byNum << endl;
     }
 
+    virtual ~qCSC()
+    {
+    }
+
+    /**
+     * Sets the optional outputs gathered during the scan
+     *
+     * @param top Heap collecting the k best rotations or NULL
+     * @param profile Profile receiving every scanned distance or NULL
+     */
+    void setOutputs(struct TTopK * top, struct TProfile * profile)
+    {
+	this->top = top;
+	this->profile = profile;
+    }
+
     /**
-     * Destructor to free reserved memory
+     * Sets how widely the engine searches
+     *
+     * @param candidates The number of best blocks to refine, at least 1
+     * @param threads The number of threads to refine them on, at least 1
      */
-    ~qCSC()
+    void setSearch(unsigned int candidates, unsigned int threads)
     {
-	free(this->chars);
+	this->candidates = max(1u, candidates);
+	this->threads = max(1u, threads);
     }
 
     /**
@@ -341,5 +453,54 @@ public:
     virtual int run(struct BestMatch * best) = 0;
 };
 
-#endif
+/**
+ * Runs the q-gram engine T over alphabet A with the narrowest keys that hold
+ * a q-gram exactly: 64 bits, 128 bits, or verified hashes past that
+ */
+template <template <class> class T, class A>
+int runQGramEngine(string xx, unsigned int m, string y, unsigned int n, unsigned int q, unsigned int b,
+		   unsigned int candidates, unsigned int threads, struct TTopK * top, struct TProfile * profile, struct BestMatch * best)
+{
+    if (q <= TQGramEncoder<A, WORD>::maxQ) {
+	T<TQGramEncoder<A, WORD>> e(xx, m, y, n, q, b);
+	e.setOutputs(top, profile);
+	e.setSearch(candidates, threads);
+	return e.run(best);
+    } else if (q <= TQGramEncoder<A, WIDE_WORD>::maxQ) {
+	T<TQGramEncoder<A, WIDE_WORD>> e(xx, m, y, n, q, b);
+	e.setOutputs(top, profile);
+	e.setSearch(candidates, threads);
+	return e.run(best);
+    } else {
+	T<TQGramHasher<A>> e(xx, m, y, n, q, b);
+	e.setOutputs(top, profile);
+	e.setSearch(candidates, threads);
+	return e.run(best);
+    }
+}
+
+/**
+ * Runs the q-gram engine T instantiated for the alphabet of the -a flag
+ *
+ * @tparam T hCSC or nCSC
+ * @param alphabet The letters of the alphabet: DNA, RNA, IUPAC or PROT
+ * @param candidates The number of best blocks hCSC refines
+ * @param threads The number of threads hCSC refines them on
+ * @return The exit status of T::run
+ */
+template <template <class> class T>
+int runQGramEngine(string xx, unsigned int m, string y, unsigned int n, unsigned int q, unsigned int b, const char * alphabet,
+		   unsigned int candidates, unsigned int threads, struct TTopK * top, struct TProfile * profile, struct BestMatch * best)
+{
+    if (strcmp(alphabet, DNA) == 0) {
+	return runQGramEngine<T, TDNAAlphabet>(xx, m, y, n, q, b, candidates, threads, top, profile, best);
+    } else if (strcmp(alphabet, RNA) == 0) {
+	return runQGramEngine<T, TRNAAlphabet>(xx, m, y, n, q, b, candidates, threads, top, profile, best);
+    } else if (strcmp(alphabet, PROT) == 0) {
+	return runQGramEngine<T, TProteinAlphabet>(xx, m, y, n, q, b, candidates, threads, top, profile, best);
+    } else {
+	return runQGramEngine<T, TIUPACAlphabet>(xx, m, y, n, q, b, candidates, threads, top, profile, best);
+    }
+}
 
+#endif
@@ -0,0 +1,212 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "csc.h"
+#include "sacsc.h"
+
+using namespace std;
+
+#define ANCHOR_CANDIDATES       16                      // the most voted rotations that are scanned
+#define ANCHOR_MAX_HITS         64                      // anchors with more x-y occurrence pairs are repeats and do not vote
+
+/*
+Collects the anchors, the K-mers shared by x and y, from the SA and LCP
+arrays of xxy: the suffixes sharing a K-mer are consecutive in SA, and
+every occurrence in x at p paired with every occurrence in y at j votes for
+rotation ( p - j ) mod m. A maximal exact match of length L lies on one
+diagonal and gives it L - K + 1 votes. Returns the number of votes cast.
+*/
+static INT anchor_votes ( INT * SA, INT * LCP, INT m, INT n, INT K, unsigned int * votes )
+{
+	INT mmn = m + m + n;
+	INT cast = 0;
+	vector<INT> xo, yo;
+
+	for ( INT i = 0; i <= mmn; i++ )
+	{
+		if ( i == mmn || LCP[i] < K )
+		{
+			/* Close the group of suffixes sharing a K-mer */
+			if ( ! xo . empty () && ! yo . empty () && xo . size () * yo . size () <= ANCHOR_MAX_HITS )
+			{
+				for ( INT p : xo )
+					for ( INT j : yo )
+					{
+						votes[( p - j % m + m ) % m]++;
+						cast++;
+					}
+			}
+			xo . clear ();
+			yo . clear ();
+			if ( i == mmn )	break;
+		}
+
+		INT ii = SA[i];
+		if ( ii < m )					//once per circular K-mer of x
+			xo . push_back ( ii );
+		else if ( ii >= m + m && ii <= mmn - K )	//the K-mers of y
+			yo . push_back ( ii - m - m );
+	}
+
+	return ( cast );
+}
+
+/*
+Estimates the best rotation of x against y from a shortlist of rotations
+instead of scanning every rotation: the rotations most voted by the exact
+anchors of length sw . anchor, found on the SA and LCP arrays of xxy, and
+the sw . fft rotations with the most letter matches, found by FFT cross-
+correlation. Only the shortlist is scanned for its blockwise q-gram
+distance; the full scan is the fallback when the shortlist is empty.
+*/
+unsigned int sacsc_shortlist_comparison (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance, struct TTopK * top )
+{
+	INT m = strlen ( ( char * ) x );
+	INT n = strlen ( ( char * ) y );
+	INT q = sw . q;
+	INT b = m / sw . l;
+	INT K = sw . anchor;
+	if ( K > m )	K = m;
+
+	INT * xp = ( INT * ) calloc( ( m + m - q + 1 ) , sizeof( INT ) ); // x'
+	INT * yp = ( INT * ) calloc( ( n - q + 1 ) , sizeof( INT ) ); // y'
+	unsigned int * votes = ( unsigned int * ) calloc ( m, sizeof ( unsigned int ) );
+	if ( xp == NULL || yp == NULL || votes == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the shortlist.\n" );
+                return ( 0 );
+	}
+
+	/* The anchors vote on the SA and LCP arrays that also rank the q-grams */
+	INT cast = 0;
+	INT sigma;
+	if ( K )
+	{
+		unsigned char * xxy;
+		INT * SA;
+		INT * LCP;
+		if ( ! build_xxy_index ( x, y, m, n, &xxy, &SA, &LCP ) )
+			return ( 0 );
+		cast = anchor_votes ( SA, LCP, m, n, K, votes );
+		sigma = qgram_ranking ( SA, LCP, m, n, q, xp, yp );
+		free ( xxy );
+		free ( SA );
+		free ( LCP );
+		if ( cast == 0 )
+			fprintf ( stderr, " Warning: No anchors of length %ld were found.\n", ( long ) K );
+	}
+	else if ( ( sigma = rank_xxy ( x, y, m, n, q, xp, yp, sw . T ) ) < 0 )
+		return ( 0 );
+
+	/* The most voted rotations, ties broken by the smaller rotation */
+	INT p = circular_period ( xp, m );
+	for ( INT r = p; r < m; r++ )	//rotation r of a periodic x is rotation r % p
+		votes[r % p] += votes[r];
+	vector<INT> cand;
+	for ( INT r = 0; r < p; r++ )
+		if ( votes[r] )	cand . push_back ( r );
+	INT c = ( sw . k > ANCHOR_CANDIDATES ) ? sw . k : ANCHOR_CANDIDATES;
+	if ( ( INT ) cand . size () > c )
+	{
+		nth_element ( cand . begin (), cand . begin () + c, cand . end (), [&] ( INT a, INT b )
+		{
+			return ( votes[a] > votes[b] || ( votes[a] == votes[b] && a < b ) );
+		} );
+		cand . resize ( c );
+	}
+	INT num_votes = cand . size ();
+
+	if ( sw . fft )
+	{
+		INT num_fft = cscmin ( ( INT ) sw . fft, p );
+		cand . resize ( num_votes + num_fft );
+		if ( ( num_fft = fft_candidates ( x, m, y, n, p, num_fft, cand . data () + num_votes ) ) < 0 )
+			return ( 0 );
+		cand . resize ( num_votes + num_fft );
+	}
+
+	/* Drop the duplicates but keep the most promising rotations first for the deadline */
+	vector<unsigned char> seen ( p, 0 );
+	INT num = 0;
+	for ( INT r : cand )
+		if ( ! seen[r] )
+		{
+			seen[r] = 1;
+			cand[num++] = r;
+		}
+	cand . resize ( num );
+
+	if ( cand . empty () )
+	{
+		fprintf ( stderr, " Warning: The shortlist is empty; scanning every rotation.\n" );
+		unsigned int ret = blockwise_scan ( xp, yp, m, n, q, b, sigma, rotation, distance, top );
+		free ( xp );
+		free ( yp );
+		free ( votes );
+		return ( ret );
+	}
+
+	INT * xind = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * xmf = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * yind = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * ymf = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * cnt = ( INT * ) calloc ( sigma + 1, sizeof ( INT ) );
+	if ( xind == NULL || xmf == NULL || yind == NULL || ymf == NULL || cnt == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the shortlist.\n" );
+                return ( 0 );
+	}
+	for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, m - q + 1, xmf, xind );
+	for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, n - q + 1, ymf, yind );
+
+	INT min_dist = -1;
+	INT rot = 0;
+	for ( INT r : cand )
+	{
+		if ( min_dist >= 0 && deadline_passed () )	break;
+		INT dist = rotation_distance ( xp, yp, b, xind, xmf, yind, ymf, r, cnt );
+		if ( top )	topk_push ( top, dist, r );
+		if ( min_dist < 0 || dist < min_dist || ( dist == min_dist && r < rot ) )
+		{
+			min_dist = dist;
+			rot = r;
+		}
+	}
+	if ( K )
+		fprintf ( stderr, " Anchors of length %ld cast %ld votes over %ld shortlisted rotations.\n", ( long ) K, ( long ) cast, ( long ) num_votes );
+	fprintf ( stderr, " Scanned %ld shortlisted rotations of %ld.\n", ( long ) cand . size (), ( long ) p );
+
+	( * distance ) = ( unsigned int ) min_dist;
+	( * rotation ) = ( unsigned int ) rot;
+
+	free ( xp );
+	free ( yp );
+	free ( votes );
+	free ( xind );
+	free ( xmf );
+	free ( yind );
+	free ( ymf );
+	free ( cnt );
+	return ( 1 );
+}
@@ -0,0 +1,514 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+
+#include "csc.h"
+#include "sacsc.h"
+
+using namespace std;
+
+/*
+Builds the collection index: the text s_0 s_0[0..q-2] $ s_1 s_1[0..q-2] $ ...
+is suffix-sorted once and every circular q-gram of every sequence is given
+a global rank from the LCP array. The rank of the circular q-gram of s_i at
+p is stored at R[start[i] + p].
+*/
+unsigned int sacsc_build_collection ( unsigned char ** seq, INT num, INT q, struct TCollection * c )
+{
+	INT t = 0;
+
+	c -> num = num;
+	c -> q = q;
+	c -> start = ( INT * ) calloc ( num, sizeof ( INT ) );
+	c -> len = ( INT * ) calloc ( num, sizeof ( INT ) );
+	if ( c -> start == NULL || c -> len == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the collection index.\n" );
+                return ( 0 );
+	}
+	for ( INT i = 0; i < num; i++ )
+	{
+		c -> len[i] = strlen ( ( char * ) seq[i] );
+		c -> start[i] = t;
+		t += c -> len[i] + q;
+	}
+
+	unsigned char * text = ( unsigned char * ) calloc ( t + 1, sizeof ( unsigned char ) );
+	INT * SA = ( INT * ) malloc ( t * sizeof ( INT ) );
+	INT * LCP = ( INT * ) calloc ( t, sizeof ( INT ) );
+	INT * owner = ( INT * ) malloc ( t * sizeof ( INT ) );
+	c -> R = ( INT * ) calloc ( t, sizeof ( INT ) );
+	if ( text == NULL || SA == NULL || LCP == NULL || owner == NULL || c -> R == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the collection index.\n" );
+                return ( 0 );
+	}
+
+	/* Each sequence is extended by its first q - 1 letters so that its circular q-grams are consecutive */
+	for ( INT i = 0; i < num; i++ )
+	{
+		INT m = c -> len[i];
+		unsigned char * s = text + c -> start[i];
+		for ( INT p = 0; p < m + q - 1; p++ )
+		{
+			s[p] = seq[i][p % m];
+			owner[c -> start[i] + p] = ( p < m ) ? i : -1;
+		}
+		s[m + q - 1] = DEL;
+		owner[c -> start[i] + m + q - 1] = -1;
+	}
+
+	if ( ! suffix_array_lcp ( text, t, SA, LCP ) )
+		return ( 0 );
+
+	/* Only the q-grams starting in the first copy of a sequence are ranked, the rest still bound the LCP */
+	INT sigma = -1;
+	INT lcp = 0;
+	for ( INT i = 0; i < t; i++ )
+	{
+		lcp = cscmin ( lcp, LCP[i] );
+		if ( owner[SA[i]] >= 0 )
+		{
+			if ( lcp < q )	sigma++;
+			c -> R[SA[i]] = sigma;
+			lcp = q;
+		}
+	}
+	c -> sigma = sigma;
+
+	free ( text );
+	free ( SA );
+	free ( LCP );
+	free ( owner );
+	return ( 1 );
+}
+
+void sacsc_free_collection ( struct TCollection * c )
+{
+	free ( c -> start );
+	free ( c -> len );
+	free ( c -> R );
+}
+
+/*
+Runs Step 1 to Step 3 of x = s_i against y = s_j on the shared ranks. The
+global ranks of the pair are first renamed to dense ids, so that diff only
+needs as many entries as the pair has distinct q-grams; local is a scratch
+array of c -> sigma + 1 entries set to -1, which is restored on return.
+*/
+unsigned int sacsc_collection_comparison ( struct TCollection * c, INT i, INT j, INT l, INT * local, unsigned int * rotation, unsigned int * distance )
+{
+	INT m = c -> len[i];
+	INT n = c -> len[j];
+	INT q = c -> q;
+	INT * Rx = c -> R + c -> start[i];
+	INT * Ry = c -> R + c -> start[j];
+	INT sigma = -1;
+
+	INT * xp = ( INT * ) calloc ( m + m - q + 1, sizeof ( INT ) );
+	INT * yp = ( INT * ) calloc ( n - q + 1, sizeof ( INT ) );
+	if ( xp == NULL || yp == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for x' and y'.\n" );
+                return ( 0 );
+	}
+
+	for ( INT p = 0; p < m; p++ )
+	{
+		if ( local[Rx[p]] < 0 )	local[Rx[p]] = ++ sigma;
+		xp[p] = local[Rx[p]];
+	}
+	for ( INT p = m; p < m + m - q + 1; p++ )	xp[p] = xp[p - m];
+	for ( INT p = 0; p < n - q + 1; p++ )
+	{
+		if ( local[Ry[p]] < 0 )	local[Ry[p]] = ++ sigma;
+		yp[p] = local[Ry[p]];
+	}
+	for ( INT p = 0; p < m; p++ )		local[Rx[p]] = -1;
+	for ( INT p = 0; p < n - q + 1; p++ )	local[Ry[p]] = -1;
+
+	unsigned int ret = blockwise_scan ( xp, yp, m, n, q, m / l, sigma, rotation, distance );
+
+	free ( xp );
+	free ( yp );
+	return ( ret );
+}
+
+/*
+Compares x = s_0 against the queries s_1, s_2, ... in groups of sw . multi:
+the scans of a group share x', its partition and a single renaming of the
+ranks, and advance together so that every pass over x' serves the whole
+group. The groups run on sw . T threads.
+*/
+unsigned int sacsc_multi_query ( unsigned char ** seq, unsigned char ** seq_id, unsigned int num_seqs, struct TSwitch  sw, FILE * out_fd )
+{
+	struct TCollection c;
+	INT q = sw . q;
+	INT l = sw . l;
+	INT k = sw . multi;
+
+	for ( unsigned int i = 0; i < num_seqs; i++ )
+	{
+		if ( ( INT ) strlen ( ( char * ) seq[i] ) < q )
+		{
+			fprintf( stderr, " Error: Sequence %s is shorter than the q-gram length.\n", seq_id[i] );
+			return ( 0 );
+		}
+	}
+
+	if ( ! sacsc_build_collection ( seq, num_seqs, q, &c ) )
+		return ( 0 );
+
+	INT m = c . len[0];
+	INT b = m / l;
+	if ( l < 1 || q >= l || l > m - q + 1 )
+	{
+        	fprintf( stderr, " Error: Illegal block length.\n" );
+		return ( 0 );
+	}
+	INT * xind = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * xmf = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * query = ( INT * ) calloc ( num_seqs, sizeof ( INT ) );
+	TPOcc * res = ( TPOcc * ) calloc ( num_seqs, sizeof ( TPOcc ) );
+	unsigned char * valid = ( unsigned char * ) calloc ( num_seqs, sizeof ( unsigned char ) );
+	if ( xind == NULL || xmf == NULL || query == NULL || res == NULL || valid == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the queries.\n" );
+                return ( 0 );
+	}
+	for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, m - q + 1, xmf, xind );
+
+	INT nv = 0;
+	for ( unsigned int j = 1; j < num_seqs; j++ )
+		if ( l <= c . len[j] - q + 1 )
+			query[nv++] = j;
+
+	INT groups = ( nv + k - 1 ) / k;
+	INT p = circular_period ( c . R + c . start[0], m );	//the distinct rotations of x
+	std::atomic<INT> next ( 0 );
+	std::atomic<unsigned int> ok ( 1 );
+	auto worker = [&] ()
+	{
+		INT * local = ( INT * ) malloc ( ( c . sigma + 1 ) * sizeof ( INT ) );
+		INT * xp = ( INT * ) malloc ( ( m + m - q + 1 ) * sizeof ( INT ) );
+		INT ** yp = ( INT ** ) calloc ( k, sizeof ( INT * ) );
+		INT * min_dist = ( INT * ) calloc ( k, sizeof ( INT ) );
+		INT * rot = ( INT * ) calloc ( k, sizeof ( INT ) );
+		struct TScan * s = ( struct TScan * ) calloc ( k, sizeof ( struct TScan ) );
+		if ( local == NULL || xp == NULL || yp == NULL || min_dist == NULL || rot == NULL || s == NULL )
+		{
+			fprintf ( stderr, " Error: Cannot allocate memory for the queries.\n" );
+			ok = 0;
+		}
+		else	for ( INT r = 0; r <= c . sigma; r++ )	local[r] = -1;
+
+		INT g;
+		while ( ok && ( g = next ++ ) < groups )
+		{
+			INT * Q = query + g * k;
+			INT kk = cscmin ( k, nv - g * k );
+			INT sigma = -1;
+			INT * Rx = c . R + c . start[0];
+
+			/* One renaming of the ranks for x and the whole group */
+			for ( INT p = 0; p < m; p++ )
+			{
+				if ( local[Rx[p]] < 0 )	local[Rx[p]] = ++ sigma;
+				xp[p] = local[Rx[p]];
+			}
+			for ( INT p = m; p < m + m - q + 1; p++ )	xp[p] = xp[p - m];
+			for ( INT t = 0; t < kk; t++ )
+			{
+				INT nn = c . len[Q[t]] - q + 1;
+				INT * Ry = c . R + c . start[Q[t]];
+				if ( ( yp[t] = ( INT * ) malloc ( nn * sizeof ( INT ) ) ) == NULL )
+				{
+					fprintf ( stderr, " Error: Cannot allocate memory for y'.\n" );
+					ok = 0;
+					break;
+				}
+				for ( INT p = 0; p < nn; p++ )
+				{
+					if ( local[Ry[p]] < 0 )	local[Ry[p]] = ++ sigma;
+					yp[t][p] = local[Ry[p]];
+				}
+			}
+			for ( INT p = 0; p < m; p++ )	local[Rx[p]] = -1;
+			for ( INT t = 0; t < kk; t++ )
+			{
+				INT * Ry = c . R + c . start[Q[t]];
+				for ( INT p = 0; p < c . len[Q[t]] - q + 1; p++ )	local[Ry[p]] = -1;
+			}
+
+			/* A failed allocation stops the group before scanning; its partial scans are freed below */
+			INT ready = 0;
+			for ( INT t = 0; ok && t < kk; t++, ready++ )
+			{
+				if ( ! scan_init ( &s[t], xp, yp[t], m, c . len[Q[t]], q, b, sigma, xind, xmf ) )
+					ok = 0;
+				min_dist[t] = s[t] . dist;
+				rot[t] = 0;
+			}
+			if ( ! ok )
+			{
+				for ( INT t = 0; t < ready; t++ )	scan_free ( &s[t] );
+				for ( INT t = 0; t < kk; t++ )
+				{
+					free ( yp[t] );
+					yp[t] = NULL;
+				}
+				break;
+			}
+			for ( INT i = 1; i < p; i++ )
+			{
+				scan_next_multi ( s, kk );
+				for ( INT t = 0; t < kk; t++ )
+				{
+					if ( s[t] . dist < min_dist[t] )
+					{
+						min_dist[t] = s[t] . dist;
+						rot[t] = i;
+					}
+				}
+			}
+			for ( INT t = 0; t < kk; t++ )
+			{
+				res[Q[t]] . err = min_dist[t];
+				res[Q[t]] . rot = rot[t];
+				valid[Q[t]] = 1;
+				scan_free ( &s[t] );
+				free ( yp[t] );
+				yp[t] = NULL;
+			}
+		}
+		free ( local );
+		free ( xp );
+		free ( yp );
+		free ( min_dist );
+		free ( rot );
+		free ( s );
+	};
+	std::vector<std::thread> threads;
+	for ( unsigned int i = 1; i < sw . T && i < groups; i++ )	threads . push_back ( std::thread ( worker ) );
+	worker ();
+	for ( auto & t : threads )	t . join ();
+	if ( ! ok )
+	{
+		sacsc_free_collection ( &c );
+		free ( xind );
+		free ( xmf );
+		free ( query );
+		free ( res );
+		free ( valid );
+		return ( 0 );
+	}
+
+	fprintf ( out_fd, "#x_id\ty_id\tx_length\ty_length\tdistance\trotation\n" );
+	for ( unsigned int j = 1; j < num_seqs; j++ )
+	{
+		if ( ! valid[j] )
+		{
+        		fprintf( stderr, " Warning: Skipping pair (%s, %s): illegal block length.\n", seq_id[0], seq_id[j] );
+			continue;
+		}
+		fprintf ( out_fd, "%s\t%s\t%u\t%u\t%u\t%u\n", seq_id[0], seq_id[j], ( unsigned int ) m, ( unsigned int ) c . len[j], res[j] . err, res[j] . rot );
+	}
+
+	sacsc_free_collection ( &c );
+	free ( xind );
+	free ( xmf );
+	free ( query );
+	free ( res );
+	free ( valid );
+	return ( 1 );
+}
+
+/*
+Groups the sequences that are exact rotations of each other: each sequence
+is hashed by its least rotation, found at offset[i] with Booth's algorithm,
+and cls[i] is set to the first sequence with the same least rotation.
+Returns the number of classes.
+*/
+static INT rotation_classes ( unsigned char ** seq, INT * len, INT num, INT * cls, INT * offset )
+{
+	unordered_map<uint64_t, vector<INT>> reps;
+	INT num_cls = 0;
+
+	for ( INT i = 0; i < num; i++ )
+	{
+		INT m = len[i];
+		offset[i] = least_rotation ( seq[i], m );
+
+		uint64_t h = 14695981039346656037ULL;		//FNV-1a of the least rotation
+		for ( INT p = 0; p < m; p++ )
+			h = ( h ^ seq[i][( offset[i] + p ) % m] ) * 1099511628211ULL;
+
+		cls[i] = i;
+		vector<INT> & bucket = reps[h];
+		for ( INT r : bucket )
+		{
+			INT p = 0;
+			if ( len[r] == m )
+				while ( p < m && seq[r][( offset[r] + p ) % m] == seq[i][( offset[i] + p ) % m] )	p++;
+			if ( p == m )
+			{
+				cls[i] = r;
+				break;
+			}
+		}
+		if ( cls[i] == i )
+		{
+			bucket . push_back ( i );
+			num_cls++;
+		}
+	}
+
+	return ( num_cls );
+}
+
+/*
+Compares every ordered pair of sequences with saCSC on a single collection
+index, scanning pairs of equal lengths together in lanes, and writes one
+result row per pair to out_fd. Sequences that are exact rotations of each
+other form a class: a pair within a class has distance 0 at the rotation
+that maps x onto y, and only the first member of a class is scanned as x,
+the others taking its results shifted by their offset. y is partitioned
+linearly, so every member is still compared as y.
+*/
+unsigned int sacsc_all_vs_all ( unsigned char ** seq, unsigned char ** seq_id, unsigned int num_seqs, struct TSwitch  sw, FILE * out_fd )
+{
+	struct TCollection c;
+	INT q = sw . q;
+	INT l = sw . l;
+
+	for ( unsigned int i = 0; i < num_seqs; i++ )
+	{
+		if ( ( INT ) strlen ( ( char * ) seq[i] ) < q )
+		{
+			fprintf( stderr, " Error: Sequence %s is shorter than the q-gram length.\n", seq_id[i] );
+			return ( 0 );
+		}
+	}
+
+	if ( ! sacsc_build_collection ( seq, num_seqs, q, &c ) )
+		return ( 0 );
+
+	INT * cls = ( INT * ) calloc ( num_seqs, sizeof ( INT ) );
+	INT * offset = ( INT * ) calloc ( num_seqs, sizeof ( INT ) );
+	INT * period = ( INT * ) calloc ( num_seqs, sizeof ( INT ) );
+	if ( cls == NULL || offset == NULL || period == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the rotation classes.\n" );
+                return ( 0 );
+	}
+	INT num_cls = rotation_classes ( seq, c . len, num_seqs, cls, offset );
+	for ( unsigned int i = 0; i < num_seqs; i++ )	period[i] = circular_period ( seq[i], c . len[i] );
+	fprintf( stderr, " Rotation classes         : %ld of %u sequences\n", ( long ) num_cls, num_seqs );
+
+	/* The pairs within a class are set from the offsets; the first member of every other class is scanned in lanes */
+	INT num = ( INT ) num_seqs * num_seqs;	//unsigned int overflows past 65535 sequences
+	TPOcc * res = ( TPOcc * ) calloc ( num, sizeof ( TPOcc ) );
+	unsigned char * valid = ( unsigned char * ) calloc ( num, sizeof ( unsigned char ) );
+	if ( res == NULL || valid == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the pairs.\n" );
+                return ( 0 );
+	}
+	vector<INT> xs, ys, task;
+	for ( INT t = 0; t < num; t++ )
+	{
+		INT i = t / num_seqs;
+		INT j = t % num_seqs;
+		INT m = c . len[i];
+		INT n = c . len[j];
+		if ( i == j || l < 1 || q >= l || l > m - q + 1 || l > n - q + 1 )	continue;
+		if ( cls[i] == cls[j] )
+		{
+			/* rot ( x, offset[i] ) = rot ( y, offset[j] ), hence y = rot ( x, offset[i] - offset[j] ) */
+			res[t] . err = 0;
+			res[t] . rot = ( ( offset[i] - offset[j] + m ) % m ) % period[i];
+			valid[t] = 1;
+		}
+		else if ( cls[i] == i )
+		{
+			xs . push_back ( i );
+			ys . push_back ( j );
+			task . push_back ( t );
+		}
+	}
+	TPOcc * lres = ( TPOcc * ) calloc ( task . size () + 1, sizeof ( TPOcc ) );
+	unsigned char * lvalid = ( unsigned char * ) calloc ( task . size () + 1, sizeof ( unsigned char ) );
+	if ( lres == NULL || lvalid == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the pairs.\n" );
+                return ( 0 );
+	}
+	if ( ! sacsc_lane_comparisons ( &c, xs . data (), ys . data (), task . size (), l, sw . T, lres, lvalid ) )
+		return ( 0 );
+	for ( unsigned int k = 0; k < task . size (); k++ )
+	{
+		res[task[k]] = lres[k];
+		valid[task[k]] = lvalid[k];
+	}
+	free ( lres );
+	free ( lvalid );
+
+	/* x = rot ( x_a, d ) with d = offset[a] - offset[x], so rotation r of x_a is rotation r - d of x */
+	for ( INT t = 0; t < num; t++ )
+	{
+		INT i = t / num_seqs;
+		INT j = t % num_seqs;
+		INT a = cls[i];
+		if ( a == i || a == cls[j] )	continue;
+		INT m = c . len[i];
+		INT d = ( offset[a] - offset[i] + m ) % m;
+		valid[t] = valid[a * num_seqs + j];
+		res[t] . err = res[a * num_seqs + j] . err;
+		res[t] . rot = ( ( res[a * num_seqs + j] . rot - d + m ) % m ) % period[i];
+	}
+
+	fprintf ( out_fd, "#x_id\ty_id\tx_length\ty_length\tdistance\trotation\n" );
+	for ( INT t = 0; t < num; t++ )
+	{
+		unsigned int i = t / num_seqs;
+		unsigned int j = t % num_seqs;
+		if ( i == j )	continue;
+		if ( ! valid[t] )
+		{
+        		fprintf( stderr, " Warning: Skipping pair (%s, %s): illegal block length.\n", seq_id[i], seq_id[j] );
+			continue;
+		}
+		fprintf ( out_fd, "%s\t%s\t%u\t%u\t%u\t%u\n", seq_id[i], seq_id[j], ( unsigned int ) c . len[i], ( unsigned int ) c . len[j], res[t] . err, res[t] . rot );
+	}
+
+	sacsc_free_collection ( &c );
+	free ( cls );
+	free ( offset );
+	free ( period );
+	free ( res );
+	free ( valid );
+	return ( 1 );
+}
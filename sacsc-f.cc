@@ -0,0 +1,141 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex>
+#include <algorithm>
+#include <vector>
+
+#include "csc.h"
+#include "sacsc.h"
+
+using namespace std;
+
+typedef complex<double> TComplex;
+
+/*
+In-place iterative radix-2 FFT of a[0..N-1], N a power of two, with the
+twiddles w[k] = exp ( -2 pi i k / N ) for k < N / 2. The inverse is not
+scaled by 1 / N.
+*/
+static void fft ( TComplex * a, INT N, TComplex * w, bool inverse )
+{
+	for ( INT i = 1, j = 0; i < N; i++ )
+	{
+		INT bit = N >> 1;
+		for ( ; j & bit; bit >>= 1 )	j ^= bit;
+		j ^= bit;
+		if ( i < j )	swap ( a[i], a[j] );
+	}
+
+	for ( INT len = 2; len <= N; len <<= 1 )
+	{
+		INT half = len >> 1;
+		INT stride = N / len;
+		for ( INT i = 0; i < N; i += len )
+			for ( INT k = 0; k < half; k++ )
+			{
+				TComplex t = inverse ? conj ( w[k * stride] ) : w[k * stride];
+				TComplex v = a[i + k + half] * t;
+				a[i + k + half] = a[i + k] - v;
+				a[i + k] += v;
+			}
+	}
+}
+
+/*
+Shortlists the c rotations r < p of x with the most letter matches against
+y, that is the largest sum over j of [ x[( r + j ) mod m] = y[j] ] for
+j < min ( m, n ). The matches of every rotation are the circular cross-
+correlation of the indicator vectors of each letter in xx and y, summed over
+the letters in the frequency domain: with N >= m + min ( m, n ) no product
+wraps around, the indicators of a letter in xx and y are transformed
+together as the real and imaginary parts of one FFT and a single inverse FFT
+gives the matches of all the rotations. Writes the rotations, most matches
+first, to cand and returns their number, or -1 on failure.
+*/
+INT fft_candidates ( unsigned char * x, INT m, unsigned char * y, INT n, INT p, INT c, INT * cand )
+{
+	INT nn = cscmin ( m, n );
+	INT N = 1;
+	while ( N < m + nn )	N <<= 1;
+
+	TComplex * z = ( TComplex * ) malloc ( N * sizeof ( TComplex ) );
+	TComplex * S = ( TComplex * ) malloc ( N * sizeof ( TComplex ) );
+	TComplex * w = ( TComplex * ) malloc ( ( N / 2 + 1 ) * sizeof ( TComplex ) );
+	if ( z == NULL || S == NULL || w == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the FFT.\n" );
+                return ( -1 );
+	}
+	for ( INT k = 0; k < N / 2; k++ )	w[k] = polar ( 1.0, -2.0 * M_PI * k / N );
+	for ( INT k = 0; k < N; k++ )		S[k] = 0;
+
+	unsigned int inx[256] = { 0 };
+	unsigned int iny[256] = { 0 };
+	for ( INT i = 0; i < m; i++ )	inx[x[i]] = 1;
+	for ( INT j = 0; j < nn; j++ )	iny[y[j]] = 1;
+
+	/* S = sum over the letters of F ( xx == a ) . conj ( F ( y == a ) ) */
+	for ( unsigned int a = 0; a < 256; a++ )
+	{
+		if ( ! inx[a] || ! iny[a] )	continue;
+		for ( INT k = 0; k < N; k++ )
+		{
+			double re = ( k < m + nn - 1 && x[k % m] == a ) ? 1.0 : 0.0;
+			double im = ( k < nn && y[k] == a ) ? 1.0 : 0.0;
+			z[k] = TComplex ( re, im );
+		}
+		fft ( z, N, w, false );
+		for ( INT k = 0; k < N; k++ )
+		{
+			TComplex zc = conj ( z[( N - k ) & ( N - 1 )] );
+			TComplex X = ( z[k] + zc ) * 0.5;
+			TComplex Y = ( z[k] - zc ) * TComplex ( 0.0, -0.5 );
+			S[k] += X * conj ( Y );
+		}
+	}
+	fft ( S, N, w, true );
+
+	/* The most matches, ties broken by the smaller rotation */
+	vector<double> matches ( p );
+	vector<INT> r ( p );
+	for ( INT i = 0; i < p; i++ )
+	{
+		matches[i] = floor ( S[i] . real () / N + 0.5 );
+		r[i] = i;
+	}
+	auto more = [&] ( INT a, INT b )
+	{
+		return ( matches[a] > matches[b] || ( matches[a] == matches[b] && a < b ) );
+	};
+	c = cscmin ( c, p );
+	partial_sort ( r . begin (), r . begin () + c, r . end (), more );
+	for ( INT i = 0; i < c; i++ )	cand[i] = r[i];
+
+	fprintf ( stderr, " FFT cross-correlation of length %ld: the best rotation %ld matches %.0f of %ld letters.\n",
+			( long ) N, ( long ) r[0], matches[r[0]], ( long ) nn );
+
+	free ( z );
+	free ( S );
+	free ( w );
+	return ( c );
+}
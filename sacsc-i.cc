@@ -0,0 +1,325 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fstream>
+
+#include "csc.h"
+#include "sacsc.h"
+
+#include <sdsl/int_vector.hpp>					  // include header for int vectors
+
+using namespace sdsl;
+using namespace std;
+
+/*
+The index file is a sequence of sdsl-serialised members: the 64-bit words
+INDEX_MAGIC, INDEX_VERSION, sizeof ( INT ), m, q, l, b and sigma, followed by
+the int_vectors of the reference id, the reference sequence (one byte per
+letter, so that any alphabet is compared and written out in place), SA (the m
+circular q-gram positions of x in lexicographic order), x' (the ranks of the
+q-grams of xx), xind and xmf. A fixed-width int_vector is stored as its size
+in bits followed by its 64-bit data words, so each array can be used in place
+once the file is memory-mapped.
+*/
+#define INDEX_MAGIC             0x3158444943534343ULL   // "CCSCIDX1"
+#define INDEX_VERSION           1
+
+typedef int_vector<sizeof ( INT ) * 8> INT_VECTOR;
+
+static void store_array ( INT * a, INT len, ofstream & out )
+{
+	INT_VECTOR v ( len );
+	for ( INT i = 0; i < len; i++ )	v[i] = a[i];
+	v . serialize ( out );
+}
+
+static void store_string ( unsigned char * s, INT len, ofstream & out )
+{
+	int_vector<8> v ( len + 1, 0 );					  // keep the trailing '\0'
+	for ( INT i = 0; i < len; i++ )	v[i] = s[i];
+	v . serialize ( out );
+}
+
+/* Returns the data of the int_vector at ( * off ) and moves ( * off ) past it */
+static void * map_vector ( unsigned char * map, size_t size, size_t * off, INT width, INT len )
+{
+	uint64_t bits;
+
+	if ( len < 0 || ( uint64_t ) len > size )	return ( NULL );
+	if ( ( * off ) + sizeof ( uint64_t ) > size )	return ( NULL );
+	memcpy ( &bits, map + ( * off ), sizeof ( uint64_t ) );
+	if ( bits != ( uint64_t ) len * width )		return ( NULL );
+	( * off ) += sizeof ( uint64_t );
+	uint64_t words = ( bits + 63 ) >> 6;
+	if ( words > ( size - ( * off ) ) / sizeof ( uint64_t ) )	return ( NULL );
+	void * data = map + ( * off );
+	( * off ) += words * sizeof ( uint64_t );
+	return ( data );
+}
+
+/*
+Builds the index of reference x for the q-gram length and the block length of sw and stores it in filename
+*/
+unsigned int sacsc_build_index ( unsigned char * x, unsigned char * x_id, struct TSwitch  sw, char * filename )
+{
+	INT m = strlen ( ( char * ) x );
+	INT mm = m + m;
+	INT q = sw . q;
+	INT b = m / sw . l;
+
+	unsigned char * xx = ( unsigned char * ) calloc ( mm + 1, sizeof ( unsigned char ) );
+	INT * SA = ( INT * ) malloc ( mm * sizeof ( INT ) );
+	INT * LCP = ( INT * ) calloc ( mm, sizeof ( INT ) );
+	INT * xp = ( INT * ) calloc ( mm - q + 1, sizeof ( INT ) );
+	INT * xind = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * xmf = ( INT * ) calloc ( b, sizeof ( INT ) );
+	if ( xx == NULL || SA == NULL || LCP == NULL || xp == NULL || xind == NULL || xmf == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the index.\n" );
+                return ( 0 );
+	}
+	memcpy ( xx, x, m );
+	memcpy ( xx + m, x, m );
+
+	/* Rank the q-grams of xx on their own: y is empty */
+	if ( ! suffix_array_lcp ( xx, mm, SA, LCP ) )
+		return ( 0 );
+	INT sigma = qgram_ranking ( SA, LCP, m, 0, q, xp, NULL );
+
+	/* The suffixes starting in the first copy of x give the circular q-grams in order */
+	INT k = 0;
+	for ( INT i = 0; i < mm; i++ )
+		if ( SA[i] < m )
+			SA[k++] = SA[i];
+
+	for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, m - q + 1, xmf, xind );
+
+	ofstream out ( filename, ios::binary | ios::trunc );
+	if ( ! out )
+	{
+		fprintf ( stderr, " Error: Cannot open file %s!\n", filename );
+		return ( 0 );
+	}
+	uint64_t header[] = { INDEX_MAGIC, INDEX_VERSION, sizeof ( INT ), ( uint64_t ) m, ( uint64_t ) q, sw . l, ( uint64_t ) b, ( uint64_t ) sigma };
+	for ( unsigned int i = 0; i < sizeof ( header ) / sizeof ( uint64_t ); i++ )
+		write_member ( header[i], out );
+	store_string ( x_id, strlen ( ( char * ) x_id ), out );
+	store_string ( x, m, out );
+	store_array ( SA, m, out );
+	store_array ( xp, mm - q + 1, out );
+	store_array ( xind, b, out );
+	store_array ( xmf, b, out );
+	out . close ();
+
+	free ( xx );
+	free ( SA );
+	free ( LCP );
+	free ( xp );
+	free ( xind );
+	free ( xmf );
+
+	if ( ! out )
+	{
+		fprintf ( stderr, " Error: Cannot write file %s!\n", filename );
+		return ( 0 );
+	}
+	return ( 1 );
+}
+
+/*
+Returns 1 if the mapped arrays of idx can be used by sacsc_indexed_comparison:
+SA holds positions of x, x' holds ranks up to sigma and xind and xmf are the
+partition that partitioning gives for m, q and b. Takes O ( m ) time.
+*/
+static unsigned int index_consistent ( struct TIndex * idx )
+{
+	INT m = idx -> m;
+	INT b = idx -> b;
+
+	for ( INT i = 0; i < m; i++ )
+		if ( idx -> SA[i] < 0 || idx -> SA[i] >= m )	return ( 0 );
+	for ( INT i = 0; i < 2 * m - idx -> q + 1; i++ )
+		if ( idx -> xp[i] < 0 || idx -> xp[i] > idx -> sigma )	return ( 0 );
+
+	INT * xind = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * xmf = ( INT * ) calloc ( b, sizeof ( INT ) );
+	unsigned int ok = ( xind != NULL && xmf != NULL );
+	for ( INT j = 0; ok && j < b; j++ )
+	{
+		partitioning ( 0, j, b, m - idx -> q + 1, xmf, xind );
+		ok = ( xind[j] == idx -> xind[j] && xmf[j] == idx -> xmf[j] );
+	}
+	free ( xind );
+	free ( xmf );
+	return ( ok );
+}
+
+/* Unmaps a partly loaded index and returns the failure of sacsc_load_index */
+static unsigned int unmap_index ( struct TIndex * idx )
+{
+	munmap ( idx -> map, idx -> size );
+	idx -> map = NULL;
+	return ( 0 );
+}
+
+/*
+Memory-maps the index stored in filename
+*/
+unsigned int sacsc_load_index ( char * filename, struct TIndex * idx )
+{
+	int fd;
+	struct stat st;
+
+	if ( ( fd = open ( filename, O_RDONLY ) ) < 0 || fstat ( fd, &st ) != 0 )
+	{
+		fprintf ( stderr, " Error: Cannot open file %s!\n", filename );
+		return ( 0 );
+	}
+	idx -> size = st . st_size;
+	idx -> map = mmap ( NULL, idx -> size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close ( fd );
+	if ( idx -> map == MAP_FAILED )
+	{
+		fprintf ( stderr, " Error: Cannot map file %s!\n", filename );
+		return ( 0 );
+	}
+
+	unsigned char * map = ( unsigned char * ) idx -> map;
+	uint64_t header[8];
+	size_t off = sizeof ( header );
+	if ( idx -> size < off )
+	{
+		fprintf ( stderr, " Error: %s is not a CSC index file!\n", filename );
+		return ( unmap_index ( idx ) );
+	}
+	memcpy ( header, map, sizeof ( header ) );
+	if ( header[0] != INDEX_MAGIC )
+	{
+		fprintf ( stderr, " Error: %s is not a CSC index file!\n", filename );
+		return ( unmap_index ( idx ) );
+	}
+	if ( header[1] != INDEX_VERSION || header[2] != sizeof ( INT ) )
+	{
+		fprintf ( stderr, " Error: Index file %s has version %lu and %lu-byte integers; expected version %d and %lu-byte integers.\n",
+				filename, ( unsigned long ) header[1], ( unsigned long ) header[2], INDEX_VERSION, ( unsigned long ) sizeof ( INT ) );
+		return ( unmap_index ( idx ) );
+	}
+	/* q < l <= m - q + 1, b = m / l and the ranks of the 2m - q + 1 q-grams of xx */
+	uint64_t m = header[3], q = header[4], l = header[5];
+	if ( m == 0 || m >= idx -> size || q == 0 || q >= l || l > m - q + 1 || header[6] != m / l || header[7] > 2 * m - q )
+	{
+		fprintf ( stderr, " Error: Index file %s has inconsistent lengths!\n", filename );
+		return ( unmap_index ( idx ) );
+	}
+	idx -> m = header[3];
+	idx -> q = header[4];
+	idx -> l = header[5];
+	idx -> b = header[6];
+	idx -> sigma = header[7];
+
+	uint64_t bits = 0;
+	if ( off + sizeof ( uint64_t ) <= idx -> size )
+		memcpy ( &bits, map + off, sizeof ( uint64_t ) );
+	idx -> x_id = ( unsigned char * ) map_vector ( map, idx -> size, &off, 8, bits / 8 );
+	idx -> x = ( unsigned char * ) map_vector ( map, idx -> size, &off, 8, idx -> m + 1 );
+	idx -> SA = ( INT * ) map_vector ( map, idx -> size, &off, sizeof ( INT ) * 8, idx -> m );
+	idx -> xp = ( INT * ) map_vector ( map, idx -> size, &off, sizeof ( INT ) * 8, 2 * idx -> m - idx -> q + 1 );
+	idx -> xind = ( INT * ) map_vector ( map, idx -> size, &off, sizeof ( INT ) * 8, idx -> b );
+	idx -> xmf = ( INT * ) map_vector ( map, idx -> size, &off, sizeof ( INT ) * 8, idx -> b );
+	if ( ! idx -> x_id || ! idx -> x || ! idx -> SA || ! idx -> xp || ! idx -> xind || ! idx -> xmf
+			|| bits < 8 || idx -> x_id[bits / 8 - 1] || idx -> x[idx -> m] )
+	{
+		fprintf ( stderr, " Error: Index file %s is truncated!\n", filename );
+		return ( unmap_index ( idx ) );
+	}
+	if ( ! index_consistent ( idx ) )
+	{
+		fprintf ( stderr, " Error: Index file %s is corrupt!\n", filename );
+		return ( unmap_index ( idx ) );
+	}
+
+	return ( 1 );
+}
+
+void sacsc_unload_index ( struct TIndex * idx )
+{
+	munmap ( idx -> map, idx -> size );
+}
+
+/* Compares the q-gram of y at j with the circular q-gram of x at i */
+static inline int qgram_compare ( unsigned char * y, INT j, unsigned char * x, INT m, INT i, INT q )
+{
+	for ( INT t = 0; t < q; t++, i++ )
+	{
+		if ( i == m )	i = 0;
+		if ( y[j + t] != x[i] )
+			return ( y[j + t] < x[i] ) ? -1 : 1;
+	}
+	return ( 0 );
+}
+
+/*
+Runs saCSC of the indexed reference against y: the q-grams of y are ranked by
+binary search on the circular q-grams of x; those that do not occur in x all
+share the extra rank sigma + 1, which leaves the blockwise distance unchanged
+as x never takes them out of diff.
+*/
+unsigned int sacsc_indexed_comparison ( struct TIndex * idx, unsigned char * y, unsigned int * rotation, unsigned int * distance, struct TTopK * top, struct TProfile * profile )
+{
+	INT m = idx -> m;
+	INT n = strlen ( ( char * ) y );
+	INT q = idx -> q;
+	INT nn = n - q + 1;
+
+	INT * yp = ( INT * ) calloc ( nn, sizeof ( INT ) );
+	if ( yp == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for y'.\n" );
+                return ( 0 );
+	}
+
+	for ( INT j = 0; j < nn; j++ )
+	{
+		INT lo = 0;
+		INT hi = m;
+		while ( lo < hi )
+		{
+			INT mid = lo + ( hi - lo ) / 2;
+			if ( qgram_compare ( y, j, idx -> x, m, idx -> SA[mid], q ) > 0 )
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if ( lo < m && qgram_compare ( y, j, idx -> x, m, idx -> SA[lo], q ) == 0 )
+			yp[j] = idx -> xp[idx -> SA[lo]];
+		else
+			yp[j] = idx -> sigma + 1;
+	}
+
+	unsigned int ret = blockwise_scan ( idx -> xp, yp, m, n, q, idx -> b, idx -> sigma + 1, rotation, distance, top, profile, idx -> xind, idx -> xmf );
+
+	free ( yp );
+	return ( ret );
+}
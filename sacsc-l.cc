@@ -0,0 +1,349 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "csc.h"
+#include "sacsc.h"
+
+using namespace std;
+
+#define LANES                   8                       // the pairs scanned together
+
+/*
+Scans the k <= LANES pairs ( xs[t], ys[t] ) of the collection, which all
+have the same lengths m and n, in lockstep. Every array is laid out
+structure-of-arrays with the LANES pairs interleaved: the ranks of each
+pair are renamed to dense ids as in sacsc_collection_comparison and stored
+premultiplied as id * LANES + t, so that cell ( j, id ) of the diff table
+of pair t is at ( j * W + id ) * LANES + t for the widest W of the group.
+Every step of the scan then loads the letters out and in of a block for all
+the lanes at once and updates D and the distances lane by lane in a loop of
+fixed width. The unused lanes scan empty ranks. Each pair keeps its first
+minimum over the rotations before the longest period of the group, which
+is the minimum over its own period.
+*/
+static unsigned int lane_scan ( struct TCollection * c, INT * xs, INT * ys, INT k, INT l, INT * local, TPOcc * res )
+{
+	INT m = c -> len[xs[0]];
+	INT n = c -> len[ys[0]];
+	INT q = c -> q;
+	INT b = m / l;
+	INT mm = m + m - q + 1;
+	INT nn = n - q + 1;
+
+	INT * xo = ( INT * ) calloc ( mm * LANES, sizeof ( INT ) );
+	INT * yo = ( INT * ) calloc ( nn * LANES, sizeof ( INT ) );
+	INT * xind = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * xmf = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * yind = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * ymf = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * D = ( INT * ) calloc ( b * LANES, sizeof ( INT ) );
+	if ( xo == NULL || yo == NULL || xind == NULL || xmf == NULL || yind == NULL || ymf == NULL || D == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the lanes.\n" );
+                return ( 0 );
+	}
+
+	/* Rename the ranks of every pair and interleave x' and y' */
+	INT W = 1;
+	INT P = 1;
+	INT period[LANES];
+	for ( INT t = 0; t < k; t++ )
+	{
+		INT * Rx = c -> R + c -> start[xs[t]];
+		INT * Ry = c -> R + c -> start[ys[t]];
+		INT sigma = -1;
+		for ( INT p = 0; p < m; p++ )
+		{
+			if ( local[Rx[p]] < 0 )	local[Rx[p]] = ++ sigma;
+			xo[p * LANES + t] = local[Rx[p]];
+		}
+		for ( INT p = 0; p < nn; p++ )
+		{
+			if ( local[Ry[p]] < 0 )	local[Ry[p]] = ++ sigma;
+			yo[p * LANES + t] = local[Ry[p]];
+		}
+		for ( INT p = 0; p < m; p++ )	local[Rx[p]] = -1;
+		for ( INT p = 0; p < nn; p++ )	local[Ry[p]] = -1;
+		W = cscmax ( W, sigma + 1 );
+		period[t] = circular_period ( Rx, m );
+		P = cscmax ( P, period[t] );
+	}
+	for ( INT p = 0; p < m; p++ )
+		for ( INT t = 0; t < LANES; t++ )
+			xo[p * LANES + t] = xo[p * LANES + t] * LANES + t;
+	for ( INT p = m; p < mm; p++ )
+		for ( INT t = 0; t < LANES; t++ )
+			xo[p * LANES + t] = xo[( p - m ) * LANES + t];
+	for ( INT p = 0; p < nn * LANES; p++ )
+		yo[p] = yo[p] * LANES + ( p % LANES );
+
+	int * diff = ( int * ) calloc ( b * W * LANES, sizeof ( int ) );
+	if ( diff == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for diff.\n" );
+                return ( 0 );
+	}
+	for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, m - q + 1, xmf, xind );
+	for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, nn, ymf, yind );
+
+	/* Step 1 and Step 2 of every lane */
+	INT dist[LANES] = { 0 };
+	for ( INT j = 0; j < b; j++ )
+	{
+		int * dj = diff + j * W * LANES;
+		INT * Dj = D + j * LANES;
+		for ( INT p = yind[j]; p < yind[j] + ymf[j]; p++ )
+			for ( INT t = 0; t < LANES; t++ )
+				dj[yo[p * LANES + t]]++;
+		for ( INT t = 0; t < LANES; t++ )	Dj[t] = ymf[j];
+		for ( INT p = xind[j]; p < xind[j] + xmf[j]; p++ )
+			for ( INT t = 0; t < LANES; t++ )
+				Dj[t] += ( -- dj[xo[p * LANES + t]] >= 0 ) ? -1 : 1;
+		for ( INT t = 0; t < LANES; t++ )	dist[t] += Dj[t];
+	}
+	INT min_dist[LANES];
+	INT rot[LANES];
+	for ( INT t = 0; t < LANES; t++ )
+	{
+		min_dist[t] = dist[t];
+		rot[t] = 0;
+	}
+
+	/* Step 3 of every lane */
+	for ( INT i = 1; i < P; i++ )
+	{
+		for ( INT t = 0; t < LANES; t++ )	dist[t] = 0;
+		for ( INT j = 0; j < b; j++ )
+		{
+			int * dj = diff + j * W * LANES;
+			INT * Dj = D + j * LANES;
+			INT * out = xo + ( i - 1 + xind[j] ) * LANES;
+			INT * in = xo + ( i - 1 + xind[j] + xmf[j] ) * LANES;
+			for ( INT t = 0; t < LANES; t++ )
+			{
+				INT d = Dj[t];
+				d += ( ++ dj[out[t]] <= 0 ) ? -1 : 1;
+				d += ( -- dj[in[t]] < 0 ) ? 1 : -1;
+				Dj[t] = d;
+				dist[t] += d;
+			}
+		}
+		for ( INT t = 0; t < LANES; t++ )
+		{
+			if ( dist[t] < min_dist[t] )
+			{
+				min_dist[t] = dist[t];
+				rot[t] = i;
+			}
+		}
+	}
+	for ( INT t = 0; t < k; t++ )
+	{
+		res[t] . err = min_dist[t];
+		res[t] . rot = rot[t];
+	}
+
+	free ( xo );
+	free ( yo );
+	free ( xind );
+	free ( xmf );
+	free ( yind );
+	free ( ymf );
+	free ( D );
+	free ( diff );
+	return ( 1 );
+}
+
+/*
+Compares the num pairs ( xs[t], ys[t] ) of the collection with saCSC in
+lanes: the pairs are ordered by the lengths of x and y, consecutive pairs
+of equal lengths are grouped LANES at a time and the groups run on threads
+threads. Pairs with an illegal block length are left invalid.
+*/
+unsigned int sacsc_lane_comparisons ( struct TCollection * c, INT * xs, INT * ys, INT num, INT l, unsigned int threads, TPOcc * res, unsigned char * valid )
+{
+	INT q = c -> q;
+	vector<INT> order;
+	for ( INT t = 0; t < num; t++ )
+	{
+		INT m = c -> len[xs[t]];
+		INT n = c -> len[ys[t]];
+		if ( l >= 1 && q < l && l <= m - q + 1 && l <= n - q + 1 )
+			order . push_back ( t );
+	}
+	stable_sort ( order . begin (), order . end (), [&] ( INT a, INT b )
+	{
+		return ( c -> len[xs[a]] < c -> len[xs[b]] || ( c -> len[xs[a]] == c -> len[xs[b]] && c -> len[ys[a]] < c -> len[ys[b]] ) );
+	} );
+
+	/* The groups of at most LANES pairs of equal lengths */
+	vector<INT> group;
+	for ( INT g = 0; g < ( INT ) order . size (); g++ )
+	{
+		INT h = group . empty () ? -1 : order[group . back ()];
+		INT t = order[g];
+		if ( h < 0 || g - group . back () == LANES || c -> len[xs[h]] != c -> len[xs[t]] || c -> len[ys[h]] != c -> len[ys[t]] )
+			group . push_back ( g );
+	}
+	INT groups = group . size ();
+	group . push_back ( order . size () );
+
+	std::atomic<INT> next ( 0 );
+	std::atomic<unsigned int> ok ( 1 );
+	auto worker = [&] ()
+	{
+		INT * local = ( INT * ) malloc ( ( c -> sigma + 1 ) * sizeof ( INT ) );
+		for ( INT r = 0; r <= c -> sigma; r++ )	local[r] = -1;
+		INT g;
+		while ( ( g = next ++ ) < groups )
+		{
+			INT k = group[g + 1] - group[g];
+			INT gx[LANES], gy[LANES];
+			TPOcc gr[LANES];
+			for ( INT t = 0; t < k; t++ )
+			{
+				gx[t] = xs[order[group[g] + t]];
+				gy[t] = ys[order[group[g] + t]];
+			}
+			if ( ! lane_scan ( c, gx, gy, k, l, local, gr ) )
+			{
+				ok = 0;
+				continue;
+			}
+			for ( INT t = 0; t < k; t++ )
+			{
+				res[order[group[g] + t]] = gr[t];
+				valid[order[group[g] + t]] = 1;
+			}
+		}
+		free ( local );
+	};
+	std::vector<std::thread> pool;
+	for ( unsigned int i = 1; i < threads && i < groups; i++ )	pool . push_back ( std::thread ( worker ) );
+	worker ();
+	for ( auto & t : pool )	t . join ();
+
+	return ( ok );
+}
+
+/*
+Compares the pairs of input sequences listed in sw . pairs_filename, one
+pair of ids separated by white space per line ( lines starting with # are
+skipped ), with saCSC in lanes on one collection index, and writes one
+result row per pair to out_fd in the order of the list.
+*/
+unsigned int sacsc_pairs_list ( unsigned char ** seq, unsigned char ** seq_id, unsigned int num_seqs, struct TSwitch  sw, FILE * out_fd )
+{
+	INT q = sw . q;
+	FILE * in_fd;
+
+	if ( ! ( in_fd = fopen ( sw . pairs_filename, "r") ) )
+	{
+		fprintf ( stderr, " Error: Cannot open file %s!\n", sw . pairs_filename );
+		return ( 0 );
+	}
+
+	unordered_map<string, INT> ids;
+	for ( unsigned int i = 0; i < num_seqs; i++ )
+		ids . emplace ( ( char * ) seq_id[i], i );
+
+	vector<INT> xs, ys;
+	char * line = ( char * ) malloc ( ALLOC_SIZE * sizeof ( char ) );
+	char * a = ( char * ) malloc ( ALLOC_SIZE * sizeof ( char ) );
+	char * b = ( char * ) malloc ( ALLOC_SIZE * sizeof ( char ) );
+	if ( line == NULL || a == NULL || b == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the pairs.\n" );
+                return ( 0 );
+	}
+	INT lines = 0;
+	while ( fgets ( line, ALLOC_SIZE, in_fd ) )
+	{
+		lines++;
+		if ( line[0] == '#' || sscanf ( line, "%s", a ) != 1 )	continue;
+		if ( sscanf ( line, "%s %s", a, b ) != 2 )
+		{
+			fprintf( stderr, " Error: Line %ld of file %s does not hold a pair of ids.\n", ( long ) lines, sw . pairs_filename );
+			return ( 0 );
+		}
+		auto x = ids . find ( a );
+		auto y = ids . find ( b );
+		if ( x == ids . end () || y == ids . end () )
+		{
+			fprintf( stderr, " Error: Sequence %s is not in the input file.\n", ( x == ids . end () ) ? a : b );
+			return ( 0 );
+		}
+		xs . push_back ( x -> second );
+		ys . push_back ( y -> second );
+	}
+	fclose ( in_fd );
+	free ( line );
+	free ( a );
+	free ( b );
+
+	for ( unsigned int i = 0; i < num_seqs; i++ )
+	{
+		if ( ( INT ) strlen ( ( char * ) seq[i] ) < q )
+		{
+			fprintf( stderr, " Error: Sequence %s is shorter than the q-gram length.\n", seq_id[i] );
+			return ( 0 );
+		}
+	}
+
+	struct TCollection c;
+	if ( ! sacsc_build_collection ( seq, num_seqs, q, &c ) )
+		return ( 0 );
+
+	INT num = xs . size ();
+	TPOcc * res = ( TPOcc * ) calloc ( num + 1, sizeof ( TPOcc ) );
+	unsigned char * valid = ( unsigned char * ) calloc ( num + 1, sizeof ( unsigned char ) );
+	if ( res == NULL || valid == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the pairs.\n" );
+                return ( 0 );
+	}
+	if ( ! sacsc_lane_comparisons ( &c, xs . data (), ys . data (), num, sw . l, sw . T, res, valid ) )
+		return ( 0 );
+
+	fprintf ( out_fd, "#x_id\ty_id\tx_length\ty_length\tdistance\trotation\n" );
+	for ( INT t = 0; t < num; t++ )
+	{
+		if ( ! valid[t] )
+		{
+        		fprintf( stderr, " Warning: Skipping pair (%s, %s): illegal block length.\n", seq_id[xs[t]], seq_id[ys[t]] );
+			continue;
+		}
+		fprintf ( out_fd, "%s\t%s\t%u\t%u\t%u\t%u\n", seq_id[xs[t]], seq_id[ys[t]], ( unsigned int ) c . len[xs[t]], ( unsigned int ) c . len[ys[t]], res[t] . err, res[t] . rot );
+	}
+	fprintf( stderr, " Compared %ld listed pairs\n", ( long ) num );
+
+	sacsc_free_collection ( &c );
+	free ( res );
+	free ( valid );
+	return ( 1 );
+}
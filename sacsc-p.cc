@@ -0,0 +1,196 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "csc.h"
+#include "sacsc.h"
+
+using namespace std;
+
+#define BUCKET_BITS             16                      // the buckets are keyed by the leading 16 bits of a q-gram
+
+struct TQGram
+{
+	uint64_t             key;                    // the first letters of the q-gram packed in rank order
+	INT                  pos;                    // the starting position of the q-gram in xxy
+};
+
+/* Runs f ( begin, end, t ) on threads threads over an even split of [0, num) */
+template <typename F>
+static void parallel_for ( unsigned int threads, INT num, F f )
+{
+	vector<thread> pool;
+	for ( unsigned int t = 1; t < threads; t++ )
+		pool . push_back ( thread ( f, num * t / threads, num * ( t + 1 ) / threads, t ) );
+	f ( 0, num / threads, 0 );
+	for ( auto & th : pool )	th . join ();
+}
+
+/*
+Ranks the q-grams of xx and y of the text xxy into x' and y' on threads
+threads without a suffix array. The letters are renamed to the fewest bits
+that keep their order and the first letters of every q-gram are packed into
+a 64-bit key; the q-grams are bucketed on the leading bits of their key,
+every bucket is sorted on its own, the boundaries between distinct q-grams
+are flagged and the ranks are the prefix sums of the flags. The ranks are
+the ones qgram_ranking assigns. Returns the largest rank assigned.
+*/
+INT qgram_ranking_parallel ( unsigned char * xxy, INT m, INT n, INT q, INT * xp, INT * yp, unsigned int threads )
+{
+	INT nx = m + m - q + 1;
+	INT num = nx + n - q + 1;
+
+	/* Rename the letters of the text in order */
+	uint64_t code[256] = { 0 };
+	unsigned int seen[256] = { 0 };
+	for ( INT i = 0; i < m + m + n; i++ )	seen[xxy[i]] = 1;
+	unsigned int letters = 0;
+	for ( unsigned int c = 0; c < 256; c++ )
+		if ( seen[c] )	code[c] = letters++;
+	unsigned int bits = 1;
+	while ( ( 1U << bits ) < letters )	bits++;
+	INT L = cscmin ( q, ( INT ) ( 64 / bits ) );			//the letters in a key
+	unsigned int used = L * bits;
+	unsigned int shift = ( used > BUCKET_BITS ) ? used - BUCKET_BITS : 0;
+	uint64_t mask = ( used == 64 ) ? ~ ( uint64_t ) 0 : ( ( uint64_t ) 1 << used ) - 1;
+	INT nb = ( INT ) ( mask >> shift ) + 1;
+
+	TQGram * g = ( TQGram * ) malloc ( num * sizeof ( TQGram ) );
+	TQGram * sorted = ( TQGram * ) malloc ( num * sizeof ( TQGram ) );
+	INT * count = ( INT * ) calloc ( nb * threads, sizeof ( INT ) );
+	INT * bstart = ( INT * ) calloc ( nb + 1, sizeof ( INT ) );
+	unsigned char * flag = ( unsigned char * ) malloc ( num * sizeof ( unsigned char ) );
+	INT * chunk = ( INT * ) calloc ( threads + 1, sizeof ( INT ) );
+	if ( g == NULL || sorted == NULL || count == NULL || bstart == NULL || flag == NULL || chunk == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for the q-gram buckets.\n" );
+                return ( -1 );
+	}
+
+	/* The keys are rolled along xx and along y; the i-th q-gram starts at 2m + i - nx once in y */
+	parallel_for ( threads, num, [&] ( INT begin, INT end, unsigned int t )
+	{
+		INT * c = count + t * nb;
+		uint64_t key = 0;
+		for ( INT i = begin; i < end; i++ )
+		{
+			INT p = ( i < nx ) ? i : i - nx + m + m;
+			if ( i == begin || i == nx )
+			{
+				key = 0;
+				for ( INT j = 0; j < L; j++ )	key = ( key << bits ) | code[xxy[p + j]];
+			}
+			else
+			{
+				key = ( ( key << bits ) | code[xxy[p + L - 1]] ) & mask;
+			}
+			g[i] . key = key;
+			g[i] . pos = p;
+			c[key >> shift]++;
+		}
+	} );
+
+	/* Bucket-major, thread-minor offsets keep the scatter stable */
+	INT sum = 0;
+	for ( INT k = 0; k < nb; k++ )
+	{
+		bstart[k] = sum;
+		for ( unsigned int t = 0; t < threads; t++ )
+		{
+			INT c = count[t * nb + k];
+			count[t * nb + k] = sum;
+			sum += c;
+		}
+	}
+	bstart[nb] = sum;
+
+	parallel_for ( threads, num, [&] ( INT begin, INT end, unsigned int t )
+	{
+		INT * c = count + t * nb;
+		for ( INT i = begin; i < end; i++ )
+			sorted[c[g[i] . key >> shift]++] = g[i];
+	} );
+	free ( g );
+
+	/* Sort within the buckets on the key and then on the letters past the key; the buckets are handed out dynamically */
+	auto less = [&] ( const TQGram & a, const TQGram & b )
+	{
+		if ( a . key != b . key )	return ( a . key < b . key );
+		if ( q == L )			return ( a . pos < b . pos );
+		int c = memcmp ( xxy + a . pos + L, xxy + b . pos + L, q - L );
+		return ( c < 0 || ( c == 0 && a . pos < b . pos ) );
+	};
+	if ( shift > 0 || q > L )
+	{
+		atomic<INT> next ( 0 );
+		auto sorter = [&] ()
+		{
+			INT k;
+			while ( ( k = next ++ ) < nb )
+				if ( bstart[k + 1] - bstart[k] > 1 )
+					sort ( sorted + bstart[k], sorted + bstart[k + 1], less );
+		};
+		vector<thread> pool;
+		for ( unsigned int t = 1; t < threads; t++ )	pool . push_back ( thread ( sorter ) );
+		sorter ();
+		for ( auto & th : pool )	th . join ();
+	}
+
+	/* Flag the first q-gram of every group of equal q-grams and count the flags per chunk */
+	parallel_for ( threads, num, [&] ( INT begin, INT end, unsigned int t )
+	{
+		INT c = 0;
+		for ( INT i = begin; i < end; i++ )
+		{
+			flag[i] = ( i == 0 || sorted[i - 1] . key != sorted[i] . key ||
+				( q > L && memcmp ( xxy + sorted[i - 1] . pos + L, xxy + sorted[i] . pos + L, q - L ) != 0 ) );
+			c += flag[i];
+		}
+		chunk[t + 1] = c;
+	} );
+	for ( unsigned int t = 0; t < threads; t++ )	chunk[t + 1] += chunk[t];
+
+	/* The prefix sums of the flags are the ranks */
+	parallel_for ( threads, num, [&] ( INT begin, INT end, unsigned int t )
+	{
+		INT rank = chunk[t] - 1;
+		for ( INT i = begin; i < end; i++ )
+		{
+			rank += flag[i];
+			INT p = sorted[i] . pos;
+			if ( p < nx )	xp[p] = rank;
+			else		yp[p - m - m] = rank;
+		}
+	} );
+	INT sigma = chunk[threads] - 1;
+
+	free ( sorted );
+	free ( count );
+	free ( bstart );
+	free ( flag );
+	free ( chunk );
+	return ( sigma );
+}
@@ -24,6 +24,7 @@
 #include <assert.h>
 #include <float.h>
 #include <sys/time.h>
+#include <mutex>
 
 #include "csc.h"
 #include "sacsc.h"
@@ -33,7 +34,10 @@
 int EDNA[90];
 int BLOSUM[91];
 
-void init_substitution_score_tables ()
+/*
+Fills the letter indices of EDNA and BLOSUM once, however many threads call it
+*/
+static void fill_substitution_score_tables ()
 {
     int i;
     char edna[] = "ATGCSWRYKMBVHDN";
@@ -47,6 +51,12 @@ void init_substitution_score_tables ()
     }
 }
 
+void init_substitution_score_tables ()
+{
+    static std::once_flag filled;
+    std::call_once ( filled, fill_substitution_score_tables );
+}
+
 double delta ( char a, char b, char * alphabet )
 {
     if ( a == DEL || b == DEL ) {
@@ -153,18 +163,24 @@ unsigned int nw ( unsigned char * p, unsigned int m, unsigned char * t, unsigned
 	return EXIT_SUCCESS;
 }
 
-unsigned int sacsc_refinement (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance )
+unsigned int sacsc_refinement (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance, struct TTopK * top, struct TProfile * profile )
 {
 	unsigned int i;
 	unsigned int rot;
 	unsigned int dist;
 	double starttime = gettime();
 	
-	circular_sequence_comparison ( x, y, sw, &rot, &dist );
+	if ( sw . anchor || sw . fft )
+		sacsc_shortlist_comparison ( x, y, sw, &rot, &dist, top );
+	else if ( sw . stride || sw . time_limit > 0 )
+		sacsc_coarse_to_fine ( x, y, sw, &rot, &dist, top );
+	else
+		circular_sequence_comparison ( x, y, sw, &rot, &dist, top, profile );
 
 	double endtime = gettime() - starttime;
 
-	fprintf ( stderr, "saCSC completed in %fs with initial rotation %u.\n", endtime, rot );
+	if ( ! sw . batch )	//one line per pair would flood a batch run
+		fprintf ( stderr, "saCSC completed in %fs with initial rotation %u.\n", endtime, rot );
 
 	( * distance ) = dist;
 
@@ -239,12 +255,15 @@ unsigned int sacsc_refinement (  unsigned char * x, unsigned char * y, struct TS
 	    return EXIT_FAILURE;
 	}
 
-	fprintf ( stderr, "Refining using a sequence length of %u...\n", sl );
+	if ( ! sw . batch )
+		fprintf ( stderr, "Refining using a sequence length of %u...\n", sl );
 
 	for ( int i = 0; i < mm; i++ )
 	{
 		if ( i >= sl && i < 2 * sl )
 			continue;
+		if ( deadline_passed () )
+			break;
 	
 		Xr[0] = '\0';
 		create_rotation ( X, i, Xr );
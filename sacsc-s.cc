@@ -0,0 +1,234 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "csc.h"
+#include "sacsc.h"
+
+#define SMALL_MAX_LENGTH        8192                    // the longest x and y of the small-input engine
+#define SMALL_MAX_Q             32                      // the longest q-gram packed in a 64-bit code
+#define SMALL_MAX_BLOCKS        1024                    // the most blocks
+#define SMALL_MAX_CELLS         65536                   // the most diff cells, b ( sigma + 1 )
+#define SMALL_WORDS             ( 2 * SMALL_MAX_LENGTH / 32 + 1 )
+#define SMALL_SLOTS             ( 2 * SMALL_MAX_LENGTH )        // the most slots of the code table, a power of two
+
+/* The stack frame of the small-input engine, about 400 KB */
+struct TSmallScan
+{
+	uint64_t             px[SMALL_WORDS];        // xx packed with 2 bits per letter, the first letter in the high bits
+	uint64_t             py[SMALL_WORDS];        // y packed likewise
+	uint64_t             code[SMALL_SLOTS];      // the q-gram codes of y, hashed with linear probing
+	uint16_t             rank[SMALL_SLOTS];      // the rank of every code, 0 for an empty slot
+	uint16_t             xp[2 * SMALL_MAX_LENGTH];       // x'
+	uint16_t             yp[SMALL_MAX_LENGTH];   // y'
+	int16_t              diff[SMALL_MAX_CELLS];  // the diff table of every block, sigma + 1 cells apart
+	INT                  xind[SMALL_MAX_BLOCKS];
+	INT                  xmf[SMALL_MAX_BLOCKS];
+	INT                  yind[SMALL_MAX_BLOCKS];
+	INT                  ymf[SMALL_MAX_BLOCKS];
+	INT                  D[SMALL_MAX_BLOCKS];
+};
+
+/*
+Packs the n letters of s, repeated r times, into 2-bit words. Returns 0 when
+s holds a letter other than A, C, G and T, or both T and U.
+*/
+static unsigned int pack_2bit ( unsigned char * s, INT n, INT r, uint64_t * w, unsigned int * seen )
+{
+	static const signed char code[256] = {
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1,  0, -1,  1, -1, -1, -1,  2, -1, -1, -1, -1, -1, -1, -1, -1,	// A C G
+		-1, -1, -1, -1,  3,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,	// T U
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+	INT nw = ( n * r + 31 ) / 32;
+
+	memset ( w, 0, ( nw + 1 ) * sizeof ( uint64_t ) );
+	for ( INT i = 0; i < n; i++ )
+	{
+		int c = code[s[i]];
+		if ( c < 0 )	return ( 0 );
+		( * seen ) |= ( s[i] == 'U' ) ? 2 : ( s[i] == 'T' );
+		for ( INT k = 0; k < r; k++ )
+		{
+			INT j = i + k * n;
+			w[j >> 5] |= ( uint64_t ) c << ( 62 - 2 * ( j & 31 ) );
+		}
+	}
+
+	return ( ( * seen ) != 3 );
+}
+
+/*
+The 2q-bit code of the q-gram at position i of the packed words w
+*/
+static inline uint64_t qgram_code ( const uint64_t * w, INT i, INT q )
+{
+	INT o = ( i & 31 ) << 1;
+	uint64_t hi = w[i >> 5] << o;
+	if ( o )	hi |= w[( i >> 5 ) + 1] >> ( 64 - o );
+	return ( hi >> ( 64 - 2 * q ) );
+}
+
+static inline INT slot_of ( uint64_t c, INT bits )
+{
+	return ( INT ) ( ( c * 0x9E3779B97F4A7C15ULL ) >> ( 64 - bits ) );
+}
+
+/*
+saCSC without an index for short nucleotide sequences. x and y are packed
+into 2-bit words and every q-gram is read from the words as a 2q-bit code.
+Only the q-grams of y are ranked, through a small hash table; the q-grams
+of x missing from y share rank 0, which leaves the distance unchanged since
+y has none of them. The diff tables are then b ( sigma + 1 ) 16-bit cells
+on the stack and the scan is the one of blockwise_scan. Returns 1 with the
+same rotation, distance, top-k and profile as circular_sequence_comparison,
+or 0 without touching them when the pair is too long, has other letters
+than A, C, G and T ( or U ) or needs too many cells.
+*/
+unsigned int sacsc_small_comparison ( unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance, struct TTopK * top, struct TProfile * profile )
+{
+	INT m = strlen ( ( char * ) x );
+	INT n = strlen ( ( char * ) y );
+	INT q = sw . q;
+	INT b = m / sw . l;
+	if ( m > SMALL_MAX_LENGTH || n > SMALL_MAX_LENGTH || q > SMALL_MAX_Q || b > SMALL_MAX_BLOCKS )
+		return ( 0 );
+
+	struct TSmallScan s;
+	unsigned int seen = 0;
+	if ( ! pack_2bit ( x, m, 2, s . px, &seen ) || ! pack_2bit ( y, n, 1, s . py, &seen ) )
+		return ( 0 );
+
+	/* Rank the q-grams of y from 1 */
+	INT nn = n - q + 1;
+	INT mm = m + m - q + 1;
+	INT bits = 1;
+	while ( ( ( INT ) 1 << bits ) < 2 * nn )	bits++;
+	INT mask = ( ( INT ) 1 << bits ) - 1;
+	memset ( s . rank, 0, ( mask + 1 ) * sizeof ( uint16_t ) );
+	INT sigma = 0;
+	for ( INT j = 0; j < nn; j++ )
+	{
+		uint64_t c = qgram_code ( s . py, j, q );
+		INT h = slot_of ( c, bits );
+		while ( s . rank[h] && s . code[h] != c )	h = ( h + 1 ) & mask;
+		if ( ! s . rank[h] )
+		{
+			s . code[h] = c;
+			s . rank[h] = ++ sigma;
+		}
+		s . yp[j] = s . rank[h];
+	}
+	if ( b * ( sigma + 1 ) > SMALL_MAX_CELLS )
+		return ( 0 );
+	for ( INT j = 0; j < mm; j++ )
+	{
+		uint64_t c = qgram_code ( s . px, j, q );
+		INT h = slot_of ( c, bits );
+		while ( s . rank[h] && s . code[h] != c )	h = ( h + 1 ) & mask;
+		s . xp[j] = s . rank[h];
+	}
+
+	/* Step 1 and Step 2 of scan_init */
+	INT w = sigma + 1;
+	memset ( s . diff, 0, b * w * sizeof ( int16_t ) );
+	for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, m - q + 1, s . xmf, s . xind );
+	for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, nn, s . ymf, s . yind );
+	INT dist = 0;
+	for ( INT i = 0; i < b; i++ )
+	{
+		int16_t * diff = s . diff + i * w;
+		INT D = 0;
+		for ( INT j = s . yind[i]; j < s . yind[i] + s . ymf[i]; j++ )
+		{
+			diff[s . yp[j]]++;
+			D++;
+		}
+		for ( INT j = s . xind[i]; j < s . xind[i] + s . xmf[i]; j++ )
+			D += ( -- diff[s . xp[j]] >= 0 ) ? -1 : 1;
+		s . D[i] = D;
+		dist += D;
+	}
+
+	/* Step 3 over the p distinct rotations; the outputs of the rest are replayed from them */
+	INT p = circular_period ( s . xp, m );
+	INT * dists = ( ( top || profile ) && p < m ) ? ( INT * ) malloc ( p * sizeof ( INT ) ) : NULL;
+	INT min_dist = dist;
+	INT rot = 0;
+	if ( dists )	dists[0] = dist;
+	else
+	{
+		if ( top )	topk_push ( top, dist, 0 );
+		if ( profile )	profile_push ( profile, dist );
+	}
+	for ( INT i = 1; i < p; i++ )
+	{
+		dist = 0;
+		for ( INT j = 0; j < b; j++ )
+		{
+			int16_t * diff = s . diff + j * w;
+			INT out = s . xp[i - 1 + s . xind[j]];
+			INT in = s . xp[i - 1 + s . xind[j] + s . xmf[j]];
+			INT D = s . D[j];
+			D += ( ++ diff[out] <= 0 ) ? -1 : 1;
+			D += ( -- diff[in] < 0 ) ? 1 : -1;
+			s . D[j] = D;
+			dist += D;
+		}
+		if ( dists )	dists[i] = dist;
+		else
+		{
+			if ( top )	topk_push ( top, dist, i );
+			if ( profile )	profile_push ( profile, dist );
+		}
+		if ( dist < min_dist )
+		{
+			rot = i;
+			min_dist = dist;
+		}
+	}
+	if ( dists )
+	{
+		for ( INT i = 0; i < m; i++ )
+		{
+			if ( top )	topk_push ( top, dists[i % p], i );
+			if ( profile )	profile_push ( profile, dists[i % p] );
+		}
+		free ( dists );
+	}
+
+	( * distance ) = ( unsigned int ) min_dist;
+	( * rotation ) = ( unsigned int ) rot;
+	return ( 1 );
+}
@@ -0,0 +1,160 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "csc.h"
+#include "sacsc.h"
+
+using namespace std;
+
+#define TUNE_MAX_Q              24                      // the longest q-gram length tried
+#define TUNE_DISTINCT           0.9                     // the share of the most distinct q-grams of x the chosen q must reach
+#define TUNE_MIN_BLOCKS         8                       // q is lowered rather than have fewer blocks than this
+#define TUNE_MEMORY             512.0                   // MB of saCSC diff tables allowed without -U
+
+struct TQGramStats
+{
+	INT                  distinct_x;             // the distinct circular q-grams of x
+	INT                  distinct;               // the distinct q-grams of xx and y, the ranks saCSC assigns
+	INT                  shared_y;               // the q-grams of y occurring in x
+};
+
+/*
+Gathers the q-gram statistics of every q up to qmax from one SA and LCP of
+xxy, grouping the q-grams exactly as qgram_ranking ranks them.
+*/
+static void qgram_stats ( INT * SA, INT * LCP, INT m, INT n, INT qmax, vector<TQGramStats> & stats )
+{
+	INT mmn = m + m + n;
+
+	stats . assign ( qmax + 1, TQGramStats () );
+	for ( INT q = 1; q <= qmax; q++ )
+	{
+		TQGramStats & s = stats[q];
+		INT lcp = 0;
+		INT has_x = 0, num_y = 0;
+		s . distinct_x = s . distinct = s . shared_y = 0;
+
+		for ( INT i = 0; i <= mmn; i++ )
+		{
+			INT ii = ( i < mmn ) ? SA[i] : 0;
+			if ( i < mmn )	lcp = cscmin ( lcp, LCP[i] );
+
+			bool in_xx = ( i < mmn && ii <= m + m - q );
+			bool in_y = ( i < mmn && ii >= m + m && ii <= mmn - q );
+			if ( ! in_xx && ! in_y && i < mmn )	continue;
+
+			/* A new q-gram closes the group of the previous one */
+			if ( lcp < q || i == mmn )
+			{
+				s . distinct_x += has_x;
+				if ( has_x )	s . shared_y += num_y;
+				has_x = num_y = 0;
+				if ( i == mmn )	break;
+				s . distinct++;
+			}
+			if ( in_xx && ii < m )	has_x = 1;
+			if ( in_y )		num_y++;
+			lcp = q;
+		}
+	}
+}
+
+/*
+Chooses the q-gram length and the block length left 0 in sw from the q-gram
+statistics of x and y. q is the shortest length at which the distinct
+circular q-grams of x reach TUNE_DISTINCT of the most found at any length,
+so that q-grams stop matching by chance but are not longer than the
+sequences can tell apart. l starts at sqrt ( m ) and is raised until the b
+saCSC diff tables over the distinct q-grams fit the memory limit ( -U, or
+TUNE_MEMORY ); q is lowered while that would leave fewer than
+TUNE_MIN_BLOCKS blocks. Writes the chosen values to sw and returns 1, or 0
+on failure.
+*/
+unsigned int sacsc_tune ( unsigned char * x, unsigned char * y, struct TSwitch * sw )
+{
+	INT m = strlen ( ( char * ) x );
+	INT n = strlen ( ( char * ) y );
+	INT mn = cscmin ( m, n );
+	double budget = ( ( sw -> memory_limit > 0 ) ? sw -> memory_limit : TUNE_MEMORY ) * 1048576.0;
+
+	INT qmax = cscmin ( ( INT ) TUNE_MAX_Q, mn - 1 );
+	if ( sw -> q )	qmax = sw -> q;
+	else if ( sw -> l )	qmax = cscmin ( qmax, ( INT ) sw -> l - 1 );
+	if ( qmax < 1 )
+	{
+		fprintf ( stderr, " Error: The sequences are too short to tune q and l.\n" );
+		return ( 0 );
+	}
+
+	unsigned char * xxy;
+	INT * SA;
+	INT * LCP;
+	if ( ! build_xxy_index ( x, y, m, n, &xxy, &SA, &LCP ) )
+		return ( 0 );
+	vector<TQGramStats> stats;
+	qgram_stats ( SA, LCP, m, n, qmax, stats );
+	free ( xxy );
+	free ( SA );
+	free ( LCP );
+
+	/* The shortest q telling the q-grams of x apart about as well as any */
+	INT q = qmax;
+	if ( sw -> q == 0 )
+	{
+		INT most = 0;
+		for ( INT k = 1; k <= qmax; k++ )
+			if ( stats[k] . distinct_x > most )	most = stats[k] . distinct_x;
+		for ( q = 1; q < qmax && stats[q] . distinct_x < TUNE_DISTINCT * most; q++ );
+	}
+
+	/* The shortest l whose diff tables fit, with q lowered while there would be too few blocks */
+	INT l = sw -> l;
+	for ( ; ; q-- )
+	{
+		if ( sw -> l )	break;
+		INT fit = ( INT ) ceil ( ( double ) m * ( stats[q] . distinct + 1 ) * sizeof ( INT ) / budget );
+		INT root = ( INT ) ceil ( sqrt ( ( double ) m ) );
+		l = cscmax ( root, fit );
+		INT lmin = 2 * q;
+		l = cscmax ( l, lmin );
+		if ( m / l >= TUNE_MIN_BLOCKS || q == 1 || sw -> q )	break;
+	}
+	INT lmax = mn - q + 1;
+	l = cscmin ( l, lmax );
+	if ( q >= l )
+	{
+		fprintf ( stderr, " Error: No q-gram length shorter than the block length could be tuned.\n" );
+		return ( 0 );
+	}
+
+	INT b = m / l;
+	fprintf ( stderr, " Tuned q-gram length      : %ld (%.1f%% of the q-grams of x distinct, %.1f%% of those of y found in x)\n",
+			( long ) q, 100.0 * stats[q] . distinct_x / m, 100.0 * stats[q] . shared_y / ( n - q + 1 ) );
+	fprintf ( stderr, " Tuned block length       : %ld (%ld blocks, %.3g MB of diff tables over %ld distinct q-grams)\n",
+			( long ) l, ( long ) b, ( double ) b * ( stats[q] . distinct + 1 ) * sizeof ( INT ) / 1048576.0, ( long ) stats[q] . distinct );
+
+	sw -> q = q;
+	sw -> l = l;
+	return ( 1 );
+}
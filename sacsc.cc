@@ -35,6 +35,10 @@
 #include <divsufsort.h>                                           // include header for suffix sort
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 #include <sdsl/bit_vectors.hpp>					  // include header for bit vectors
 
 using namespace sdsl;
@@ -58,37 +62,15 @@ unsigned int LCParray ( unsigned char *text, INT n, INT * SA, INT * ISA, INT * L
 	return ( 1 );
 }
 
-unsigned int circular_sequence_comparison (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance )
+/*
+Computes the suffix array and the LCP array of text
+*/
+unsigned int suffix_array_lcp ( unsigned char * text, INT n, INT * SA, INT * LCP )
 {
-	INT * SA;
-	INT * LCP;
 	INT * invSA;
-	INT m = strlen ( ( char * ) x );
-	INT n = strlen ( ( char * ) y );
-	INT mmn = m + m + n;
-
-	unsigned char * xxy;
-        xxy = ( unsigned char * ) calloc( ( mmn + 1 ) , sizeof( unsigned char ) );
-
-	strcat ( ( char * ) xxy, ( char * ) x );
-	xxy[m] = '\0';
-	strcat ( ( char * ) xxy, ( char * ) x );
-	xxy[m + m] = '\0';
-	strcat ( ( char * ) xxy, ( char * ) y );
-	xxy[m + m + n] = '\0';
-        
-	//fprintf(stderr, " %s.\n", xxy );
-
-        /* Compute the suffix array */
-        SA = ( INT * ) malloc( ( mmn ) * sizeof( INT ) );
-        if( ( SA == NULL) )
-        {
-                fprintf(stderr, " Error: Cannot allocate memory for SA.\n" );
-                return ( 0 );
-        }
 
 	#ifdef _USE_64
-        if( divsufsort64( xxy, SA,  mmn ) != 0 )
+        if( divsufsort64( text, SA,  n ) != 0 )
         {
                 fprintf(stderr, " Error: SA computation failed.\n" );
                 exit( EXIT_FAILURE );
@@ -96,7 +78,7 @@ unsigned int circular_sequence_comparison (  unsigned char * x, unsigned char *
 	#endif
 
 	#ifdef _USE_32
-        if( divsufsort( xxy, SA,  mmn ) != 0 )
+        if( divsufsort( text, SA,  n ) != 0 )
         {
                 fprintf(stderr, " Error: SA computation failed.\n" );
                 exit( EXIT_FAILURE );
@@ -104,210 +86,770 @@ unsigned int circular_sequence_comparison (  unsigned char * x, unsigned char *
 	#endif
 
         /* Compute the inverse SA array */
-        invSA = ( INT * ) calloc( mmn , sizeof( INT ) );
+        invSA = ( INT * ) calloc( n , sizeof( INT ) );
         if( ( invSA == NULL) )
         {
                 fprintf(stderr, " Error: Cannot allocate memory for invSA.\n" );
                 return ( 0 );
         }
 
-        for ( INT i = 0; i < mmn; i ++ )
+        for ( INT i = 0; i < n; i ++ )
         {
                 invSA [SA[i]] = i;
         }
 
-	LCP = ( INT * ) calloc  ( mmn, sizeof( INT ) );
-        if( ( LCP == NULL) )
-        {
-                fprintf(stderr, " Error: Cannot allocate memory for LCP.\n" );
-                return ( 0 );
-        }
-
         /* Compute the LCP array */
-        if( LCParray( xxy, mmn, SA, invSA, LCP ) != 1 )
+        if( LCParray( text, n, SA, invSA, LCP ) != 1 )
         {
                 fprintf(stderr, " Error: LCP computation failed.\n" );
                 exit( EXIT_FAILURE );
         }
 
-	/* Ranking of q-grams and creation of x' and y' */
-	int b = (int) ( m / sw . l );
-	int q = sw . q;
-
-	//fprintf(stderr, " %d %d.\n", b, q ); getchar();
-	int sigma = 0;
-        INT mm = m + m - q + 1; 
-        INT nn = n - q + 1; 
-	INT * xp; // x'
-	INT * yp; // y'
-        xp = ( INT * ) calloc( ( mm ) , sizeof( INT ) );
-        yp = ( INT * ) calloc( ( nn ) , sizeof( INT ) );
-	
-	/* Here we rank the first q-gram in the suffix array */	
-	if ( SA[0] >= 0 && SA[0] <= m + m  - q ) // i belongs to xx
-	{
-		xp[SA[0]] = sigma;
-	}
-	if ( SA[0] >= 2*m && SA[0] <= mmn - q ) // i belongs to y
-	{
-		yp[SA[0] - 2 * m] = sigma;
-	}
-        //fprintf(stderr, " SA[0]: %d.\n", SA[0] );
+	free ( invSA );
+	return ( 1 );
+}
+
+/*
+Ranks the q-grams of xx and y, given the SA and LCP arrays of xxy, into x' and y'.
+Returns the largest rank assigned.
+*/
+INT qgram_ranking ( INT * SA, INT * LCP, INT m, INT n, INT q, INT * xp, INT * yp )
+{
+	INT mmn = m + m + n;
+	INT sigma = -1;
+	INT lcp = 0;	//the minimum LCP since the last ranked q-gram
 
-	/* Loop through the LCP array to rank the rest q-grams in the suffix array */	
-	for ( INT i = 1; i < mmn; i++ )
+	/* Loop through the LCP array to rank the q-grams in the suffix array; q-grams
+	   crossing the end of xx or y are skipped but still bound the LCP of the next one */
+	for ( INT i = 0; i < mmn; i++ )
 	{
-		INT lcp = LCP[i];
 		INT ii = SA[i];
 
-		//TODO: This could be optimised to ensure that sigma \in [0, m + 1]
-		if ( ( ii >= 0 && ii <= m + m  - q ) || ( ii >= 2 * m && ii <= mmn - q ) )
-			if ( lcp < q ) 
-			{
-				sigma++;
-				//fprintf(stderr, " SA[i]: %d.\n", SA[i] );
-			}
+		lcp = cscmin ( lcp, LCP[i] );
 
-		if ( ii >= 0 && ii <= m + m  - q ) // i belongs to xx
+		if ( ii <= m + m  - q ) // i belongs to xx
 		{
+			if ( lcp < q )	sigma++;
 			xp[ii] = sigma;
+			lcp = q;
 		}
-		if ( ii >= 2 * m && ii <= mmn - q ) // i belongs to y
+		else if ( ii >= 2 * m && ii <= mmn - q ) // i belongs to y
 		{
+			if ( lcp < q )	sigma++;
 			yp[ii - 2 * m] = sigma;
+			lcp = q;
 		}
 	}
         //fprintf(stderr, " sigma: %d.\n", sigma );
 
-	#if 0
-	for ( INT i = 0; i < mm; i++ )
-	{
-		fprintf ( stderr, "%d ", xp[i] );
-	}
-	fprintf ( stderr, "\n" );
-	for ( INT i = 0; i < nn; i++ )
-	{
-		fprintf ( stderr, "%d ", yp[i] );
-	}
-	fprintf ( stderr, "\n" );
-	#endif
+	return ( sigma );
+}
 
-	/* Partitioning x' and y' as evenly as possible */
-	INT * xind; 					//this is the starting position of the fragment
-	INT * xmf; 					//this is the number of q-grams in the fragment
-	xind = ( INT * ) calloc ( b, sizeof ( INT ) );
-	xmf = ( INT * ) calloc ( b, sizeof ( INT ) );
+/*
+Step 1 and Step 2: partitions x' and y' into b blocks, creates diff and D and
+computes the distance of rotation 0. A precomputed partition of x' may be
+passed in xind and xmf.
+*/
+unsigned int scan_init ( struct TScan * s, INT * xp, INT * yp, INT m, INT n, INT q, INT b, INT sigma, INT * xind, INT * xmf )
+{
+	INT nn = n - q + 1;
 
-	for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, m - q + 1, xmf, xind );
+	s -> xp = xp;
+	s -> yp = yp;
+	s -> m = m;
+	s -> b = b;
+	s -> sigma = sigma;
 
-	INT * yind; 					//this is the starting position of the fragment
-	INT * ymf; 					//this is the number of q-grams in the fragment
-	yind = ( INT * ) calloc ( b, sizeof ( INT ) );
-	ymf = ( INT * ) calloc ( b, sizeof ( INT ) );
+	/* Partitioning x' and y' as evenly as possible */
+	s -> own_xind = ( xind == NULL );
+	s -> xind = xind ? xind : ( INT * ) calloc ( b, sizeof ( INT ) );	//this is the starting position of the fragment
+	s -> xmf = xmf ? xmf : ( INT * ) calloc ( b, sizeof ( INT ) );		//this is the number of q-grams in the fragment
+	s -> yind = ( INT * ) calloc ( b, sizeof ( INT ) );
+	s -> ymf = ( INT * ) calloc ( b, sizeof ( INT ) );
+	s -> D = ( INT * ) calloc ( b, sizeof ( INT ) );
+	s -> diff = ( INT ** ) calloc ( b, sizeof ( INT * ) );
+	if ( s -> xind == NULL || s -> xmf == NULL || s -> yind == NULL || s -> ymf == NULL || s -> D == NULL || s -> diff == NULL )
+	{
+		fprintf ( stderr, " Error: Cannot allocate memory for the scan.\n" );
+		return ( 0 );
+	}
 
-	for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, nn, ymf, yind );
+	if ( s -> own_xind )
+		for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, m - q + 1, s -> xmf, s -> xind );
+	for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, nn, s -> ymf, s -> yind );
 
-	#if 0
+	/* Allocate the diff vector */
 	for ( INT i = 0; i < b; i++ )
 	{
-		fprintf ( stderr, "(%d %d) ", xind[i], xmf[i] );
+		if ( ( s -> diff[i] = ( INT * ) calloc ( sigma + 1, sizeof ( INT ) ) ) == NULL )
+		{
+			fprintf ( stderr, " Error: Cannot allocate memory for diff.\n" );
+			return ( 0 );
+		}
 	}
-	fprintf ( stderr, "\n" );
-	#endif
-
-	/* Allocate the diff vector */
-	INT ** diff;
-	diff = ( INT ** ) calloc ( b, sizeof ( INT * ) );
-	for ( INT i = 0; i < b; i++ )	diff[i] = ( INT * ) calloc ( sigma + 1, sizeof ( INT ) );
 
 	/* Step 1: Create diff, pvy, and D_0 */
-	INT * D;
-	D = ( INT * ) calloc ( b, sizeof ( INT * ) );
 	for ( INT i = 0; i < b; i++ )
 	{
-		for ( INT j = yind[i]; j < yind[i] + ymf[i]; j++ )
+		for ( INT j = s -> yind[i]; j < s -> yind[i] + s -> ymf[i]; j++ )
 		{
-			diff[i][yp[j]]++;	
-			D[i]++;
+			s -> diff[i][yp[j]]++;
+			s -> D[i]++;
 		}
-	}	
-	//fprintf ( stderr, "D0 = %d\n", D[0] ); getchar();
-	
+	}
+
 	/* Step 2: Compute the distances for position 0 */
-	int min_dist = 0;
+	INT dist = 0;
 	for ( INT i = 0; i < b; i++ )	//first window
-	{	
-		for ( INT j = xind[i]; j < xind[i] + xmf[i]; j++ )
+	{
+		for ( INT j = s -> xind[i]; j < s -> xind[i] + s -> xmf[i]; j++ )
 		{
-			diff[i][xp[j]]--;
-			if ( diff[i][xp[j]] >= 0 )
+			s -> diff[i][xp[j]]--;
+			if ( s -> diff[i][xp[j]] >= 0 )
 			{
-				D[i]--;
+				s -> D[i]--;
 			}
 			else
 			{
-				D[i]++;
+				s -> D[i]++;
 			}
 		}
-		min_dist += D[i];
+		dist += s -> D[i];
 	}
-	//fprintf ( stderr, "D0 = %d\n", D[0] ); getchar();
-	
-	/* Step 3: Compute the rest of the distances */
-	int rot = 0;
-	for ( INT i = 1; i < m; i++ )	//all the rest windows
+	s -> rot = 0;
+	s -> dist = dist;
+
+	return ( 1 );
+}
+
+/*
+Step 3: Slides every block of x' one position to the right and returns the
+distance of the next rotation
+*/
+INT scan_next ( struct TScan * s )
+{
+	INT i = ++ s -> rot;
+	INT * xp = s -> xp;
+	INT dist = 0;
+
+	for ( INT j = 0; j < s -> b; j++ )
 	{
-		int dist = 0;
-		for ( INT j = 0; j < b; j++ )
+		INT * diff = s -> diff[j];
+		INT out = xp[i - 1 + s -> xind[j]];
+		INT in = xp[i - 1 + s -> xind[j] + s -> xmf[j]];
+
+		//For the letter we take out
+		if ( ++ diff[out] <= 0 )
 		{
-			diff[j][xp[i - 1 + xind[j]]]++; //letter out
-			diff[j][xp[i - 1 + xind[j] + xmf[j]]]--; //letter in
+			s -> D[j]--;
+		}
+		else
+		{
+			s -> D[j]++;
+		}
 
-			//For the letter we take out
-			if ( diff[j][xp[i - 1 + xind[j]]] <= 0 )	
-			{
-				D[j]--;
-			}
-			else
-			{
-				D[j]++;
-			}
+		//For the letter we add in
+		if ( -- diff[in] < 0 )
+		{
+			s -> D[j]++;
+		}
+		else
+		{
+			s -> D[j]--;
+		}
+		dist += s -> D[j];
+	}
+	s -> dist = dist;
 
-			//For the letter we add in
-			if ( diff[j][xp[i - 1 + xind[j] + xmf[j]]] < 0 )	
-			{
-				D[j]++;
-			}
-			else
-			{							
-				D[j]--;
-			}
-			dist += D[j];
+	return ( dist );
+}
+
+/*
+Step 3 for k scans sharing x', its partition and the number of blocks: the
+letters taken out and added in are read once per block and applied to the
+diff and D of every scan
+*/
+void scan_next_multi ( struct TScan * s, INT k )
+{
+	INT i = s[0] . rot + 1;
+	INT * xp = s[0] . xp;
+	INT * xind = s[0] . xind;
+	INT * xmf = s[0] . xmf;
+
+	for ( INT t = 0; t < k; t++ )
+	{
+		s[t] . rot = i;
+		s[t] . dist = 0;
+	}
+
+	for ( INT j = 0; j < s[0] . b; j++ )
+	{
+		INT out = xp[i - 1 + xind[j]];
+		INT in = xp[i - 1 + xind[j] + xmf[j]];
+
+		for ( INT t = 0; t < k; t++ )
+		{
+			INT * diff = s[t] . diff[j];
+			INT D = s[t] . D[j];
+
+			D += ( ++ diff[out] <= 0 ) ? -1 : 1;
+			D += ( -- diff[in] < 0 ) ? 1 : -1;
+			s[t] . D[j] = D;
+			s[t] . dist += D;
+		}
+	}
+}
+
+/*
+Moves the scan to rotation r: by scan_next steps when r is at most l
+rotations ahead, otherwise by taking the q-grams of the current rotation out
+of every block and putting those of r in, at the cost of about 2m updates
+instead of the b ( sigma + 1 ) of scan_init. Returns the distance of r.
+*/
+INT scan_seek ( struct TScan * s, INT r )
+{
+	if ( r >= s -> rot && ( r - s -> rot ) * s -> b <= s -> m )
+	{
+		while ( s -> rot < r )	scan_next ( s );
+		return ( s -> dist );
+	}
+
+	INT dist = 0;
+	for ( INT i = 0; i < s -> b; i++ )
+	{
+		INT * diff = s -> diff[i];
+		INT * out = s -> xp + s -> rot + s -> xind[i];
+		INT * in = s -> xp + r + s -> xind[i];
+		for ( INT j = 0; j < s -> xmf[i]; j++ )
+			s -> D[i] += ( ++ diff[out[j]] <= 0 ) ? -1 : 1;
+		for ( INT j = 0; j < s -> xmf[i]; j++ )
+			s -> D[i] += ( -- diff[in[j]] < 0 ) ? 1 : -1;
+		dist += s -> D[i];
+	}
+	s -> rot = r;
+	s -> dist = dist;
+
+	return ( dist );
+}
+
+void scan_free ( struct TScan * s )
+{
+	if ( s -> diff )	//scan_init may have failed before allocating it
+		for ( INT i = 0; i < s -> b; i++ )	free ( s -> diff[i] );
+	free ( s -> diff );
+	free ( s -> D );
+	if ( s -> own_xind )
+	{
+		free ( s -> xind );
+		free ( s -> xmf );
+	}
+	free ( s -> yind );
+	free ( s -> ymf );
+}
+
+/*
+Computes the blockwise q-gram distance of rotation r alone, with one count
+array that is cleared after every block.
+*/
+INT rotation_distance ( INT * xp, INT * yp, INT b, INT * xind, INT * xmf, INT * yind, INT * ymf, INT r, INT * cnt )
+{
+	INT dist = 0;
+
+	for ( INT i = 0; i < b; i++ )
+	{
+		for ( INT j = yind[i]; j < yind[i] + ymf[i]; j++ )	cnt[yp[j]]++;
+		for ( INT j = xind[i]; j < xind[i] + xmf[i]; j++ )	cnt[xp[r + j]]--;
+		for ( INT j = yind[i]; j < yind[i] + ymf[i]; j++ )
+		{
+			dist += abs ( cnt[yp[j]] );
+			cnt[yp[j]] = 0;
+		}
+		for ( INT j = xind[i]; j < xind[i] + xmf[i]; j++ )
+		{
+			dist += abs ( cnt[xp[r + j]] );
+			cnt[xp[r + j]] = 0;
 		}
+	}
+
+	return ( dist );
+}
+
+/*
+Scans all the rotations of x' against y' and keeps the one with the minimum blockwise q-gram distance
+*/
+unsigned int blockwise_scan ( INT * xp, INT * yp, INT m, INT n, INT q, INT b, INT sigma, unsigned int * rotation, unsigned int * distance, struct TTopK * top, struct TProfile * profile, INT * xind, INT * xmf )
+{
+	struct TScan s;
+
+	if ( ! scan_init ( &s, xp, yp, m, n, q, b, sigma, xind, xmf ) )
+		return ( 0 );
+
+	/* Only the p distinct rotations of x are scanned; the outputs of the rest are replayed from them */
+	INT p = circular_period ( xp, m );
+	INT * dists = ( ( top || profile ) && p < m ) ? ( INT * ) malloc ( p * sizeof ( INT ) ) : NULL;
+
+	INT min_dist = s . dist;
+	INT rot = 0;
+	if ( dists )	dists[0] = min_dist;
+	else
+	{
+		if ( top )	topk_push ( top, min_dist, 0 );
+		if ( profile )	profile_push ( profile, min_dist );
+	}
+
+	for ( INT i = 1; i < p; i++ )	//all the rest windows
+	{
+		INT dist = scan_next ( &s );
+
 		//fprintf ( stderr, "dist = %d\n", dist );
+		if ( dists )	dists[i] = dist;
+		else
+		{
+			if ( top )	topk_push ( top, dist, i );
+			if ( profile )	profile_push ( profile, dist );
+		}
 		if ( dist < min_dist )
 		{
 			rot = i;
 			min_dist = dist;
 		}
 	}
-	( * distance ) = ( unsigned int ) min_dist; 
+	( * distance ) = ( unsigned int ) min_dist;
 	( * rotation ) = ( unsigned int ) rot;
 
+	if ( dists )
+	{
+		for ( INT i = 0; i < m; i++ )
+		{
+			if ( top )	topk_push ( top, dists[i % p], i );
+			if ( profile )	profile_push ( profile, dists[i % p] );
+		}
+		free ( dists );
+	}
+
+	scan_free ( &s );
+	return ( 1 );
+}
+
+/*
+Builds xxy and its SA and LCP arrays. The caller frees xxy, SA and LCP.
+*/
+unsigned int build_xxy_index ( unsigned char * x, unsigned char * y, INT m, INT n, unsigned char ** xxy, INT ** SA, INT ** LCP )
+{
+	INT mmn = m + m + n;
+
+        ( * xxy ) = ( unsigned char * ) calloc( ( mmn + 1 ) , sizeof( unsigned char ) );
+	memcpy ( ( * xxy ), x, m );
+	memcpy ( ( * xxy ) + m, x, m );
+	memcpy ( ( * xxy ) + m + m, y, n );
+
+        ( * SA ) = ( INT * ) malloc( ( mmn ) * sizeof( INT ) );
+	( * LCP ) = ( INT * ) calloc  ( mmn, sizeof( INT ) );
+        if( ( * xxy ) == NULL || ( * SA ) == NULL || ( * LCP ) == NULL )
+        {
+                fprintf(stderr, " Error: Cannot allocate memory for SA.\n" );
+                return ( 0 );
+        }
+
+	return ( suffix_array_lcp ( ( * xxy ), mmn, ( * SA ), ( * LCP ) ) );
+}
+
+/*
+Ranks the q-grams of xx and y into x' and y', through the SA and LCP arrays
+of xxy on one thread or through parallel bucket sorting on more. Returns the
+largest rank assigned or -1 on failure.
+*/
+INT rank_xxy ( unsigned char * x, unsigned char * y, INT m, INT n, INT q, INT * xp, INT * yp, unsigned int threads )
+{
+	INT sigma;
+	unsigned char * xxy;
+
+	if ( threads > 1 )
+	{
+		if ( ( xxy = ( unsigned char * ) calloc ( m + m + n + 1, sizeof ( unsigned char ) ) ) == NULL )
+		{
+	                fprintf(stderr, " Error: Cannot allocate memory for xxy.\n" );
+	                return ( -1 );
+		}
+		memcpy ( xxy, x, m );
+		memcpy ( xxy + m, x, m );
+		memcpy ( xxy + m + m, y, n );
+		sigma = qgram_ranking_parallel ( xxy, m, n, q, xp, yp, threads );
+		free ( xxy );
+		return ( sigma );
+	}
+
+	INT * SA;
+	INT * LCP;
+	if ( ! build_xxy_index ( x, y, m, n, &xxy, &SA, &LCP ) )
+		return ( -1 );
+	sigma = qgram_ranking ( SA, LCP, m, n, q, xp, yp );
+	free ( xxy );
+	free ( SA );
+	free ( LCP );
+	return ( sigma );
+}
+
+unsigned int circular_sequence_comparison (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance, struct TTopK * top, struct TProfile * profile )
+{
+	INT m = strlen ( ( char * ) x );
+	INT n = strlen ( ( char * ) y );
+
+	/* Short nucleotide pairs are compared without the index */
+	if ( sacsc_small_comparison ( x, y, sw, rotation, distance, top, profile ) )
+		return ( 1 );
+
+	/* Ranking of q-grams and creation of x' and y' */
+	INT b = m / sw . l;
+	INT q = sw . q;
+	INT * xp = ( INT * ) calloc( ( m + m - q + 1 ) , sizeof( INT ) ); // x'
+	INT * yp = ( INT * ) calloc( ( n - q + 1 ) , sizeof( INT ) ); // y'
+	INT sigma = rank_xxy ( x, y, m, n, q, xp, yp, sw . T );
+	if ( sigma < 0 )
+		return ( 0 );
+
+	unsigned int ret = blockwise_scan ( xp, yp, m, n, q, b, sigma, rotation, distance, top, profile );
+
 	/* De-allocate the memory */	
-	free ( D );
 	free ( xp );
 	free ( yp );	
+	return ( ret );
+}
+
+/*
+Searches the rotations of x coarse to fine: the rotations on a stride of
+sw . stride are evaluated on their own, and the sw . candidates gaps between
+them with the lowest lower bound are scanned at every rotation. One step of
+the scan changes the distance of every block by at most 2, hence a rotation
+t steps from an evaluated rotation of distance d has distance at least
+d - 2bt. When no gap that was not scanned has a lower bound below the
+minimum found, the minimum is the one of the exhaustive scan. The gaps are
+scanned by a single scan that seeks from one gap to the next.
+
+A coarse rotation costs about m + n steps and a rotation of a gap about 2b,
+so strides up to ( m + n ) / 2b cost more than the exhaustive scan and are
+raised. STRIDE_AUTO picks sqrt ( p ( m + n ) / 2bC ), which balances the
+p / s coarse rotations with the C gaps of s rotations. Without a stride, or
+when the stride would leave a single gap, the exhaustive scan runs instead.
+Either search stops with its best so far when the deadline passes.
+*/
+unsigned int sacsc_coarse_to_fine (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance, struct TTopK * top )
+{
+	INT m = strlen ( ( char * ) x );
+	INT n = strlen ( ( char * ) y );
+	INT b = m / sw . l;
+	INT q = sw . q;
+	INT * xp = ( INT * ) calloc( ( m + m - q + 1 ) , sizeof( INT ) ); // x'
+	INT * yp = ( INT * ) calloc( ( n - q + 1 ) , sizeof( INT ) ); // y'
+	INT sigma = rank_xxy ( x, y, m, n, q, xp, yp, sw . T );
+	if ( sigma < 0 )
+		return ( 0 );
+
+	INT p = circular_period ( xp, m );
+	INT s = 0;
+	if ( sw . stride )
+	{
+		INT smin = ( m + n ) / ( 2 * b ) + 1;
+		INT sbest = ( INT ) ceil ( sqrt ( ( double ) p * ( m + n ) / ( 2.0 * b * ( sw . candidates ? sw . candidates : 8 ) ) ) );
+		s = ( sw . stride == STRIDE_AUTO ) ? cscmax ( sbest, smin ) : sw . stride;
+		if ( s < smin )
+		{
+			fprintf ( stderr, " Warning: A stride of %ld cannot beat the exhaustive scan; using %ld.\n", ( long ) s, ( long ) smin );
+			s = smin;
+		}
+		if ( s >= p )
+		{
+			fprintf ( stderr, " Warning: A stride of %ld leaves a single gap; scanning every rotation.\n", ( long ) s );
+			s = 0;
+		}
+		else	fprintf ( stderr, " Coarse-to-fine stride is %ld.\n", ( long ) s );
+	}
+	INT k = s ? ( p + s - 1 ) / s : 0;	//the coarse rotations 0, s, ..., ( k - 1 ) s
+	INT C = sw . candidates ? sw . candidates : ( ( sw . time_limit > 0 ) ? k : 8 );
+	INT * xind = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * xmf = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * yind = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * ymf = ( INT * ) calloc ( b, sizeof ( INT ) );
+	INT * cnt = ( INT * ) calloc ( sigma + 1, sizeof ( INT ) );
+	INT * d = ( INT * ) calloc ( k + 1, sizeof ( INT ) );
+	INT * lb = ( INT * ) calloc ( k + 1, sizeof ( INT ) );
+	if ( xp == NULL || yp == NULL || xind == NULL || xmf == NULL || yind == NULL || ymf == NULL || cnt == NULL || d == NULL || lb == NULL )
+	{
+		fprintf ( stderr, " Error: Cannot allocate memory for the coarse search.\n" );
+		return ( 0 );
+	}
+	for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, m - q + 1, xmf, xind );
+	for ( INT j = 0; j < b; j++ )	partitioning ( 0, j, b, n - q + 1, ymf, yind );
+
+	double start = gettime();
+	INT min_dist = -1;
+	INT rot = 0;
+	unsigned int exact;
+
+	if ( k == 0 )
+	{
+		/* The exhaustive scan, checking the deadline every 1024 rotations */
+		struct TScan sc;
+		if ( ! scan_init ( &sc, xp, yp, m, n, q, b, sigma, xind, xmf ) )
+			return ( 0 );
+		min_dist = sc . dist;
+		if ( top )	topk_push ( top, min_dist, 0 );
+		INT r;
+		for ( r = 1; r < p; r++ )
+		{
+			if ( ( r & 1023 ) == 0 && deadline_passed () )	break;
+			INT dist = scan_next ( &sc );
+			if ( top )	topk_push ( top, dist, r );
+			if ( dist < min_dist )
+			{
+				min_dist = dist;
+				rot = r;
+			}
+		}
+		scan_free ( &sc );
+		exact = ( r == p );
+		fprintf ( stderr, " Exhaustive scan evaluated %ld rotations of %ld in %lf secs.\n", ( long ) r, ( long ) p, gettime() - start );
+	}
+	else
+	{
+		/* Coarse: evaluate the rotations on the stride; rotation p is rotation 0 */
+		INT kk = 0;
+		for ( INT i = 0; i < k; i++, kk++ )
+		{
+			if ( i > 0 && deadline_passed () )	break;
+			d[i] = rotation_distance ( xp, yp, b, xind, xmf, yind, ymf, i * s, cnt );
+			if ( top )	topk_push ( top, d[i], i * s );
+			if ( min_dist < 0 || d[i] < min_dist )
+			{
+				min_dist = d[i];
+				rot = i * s;
+			}
+		}
+		d[k] = d[0];
+
+		/* The lower bound of gap i, the rotations strictly between i s and the next coarse rotation, is
+		   the minimum over them of max ( d[i] - 2b ( r - i s ), d[i + 1] - 2b ( next - r ) ) */
+		vector<INT> order;
+		for ( INT i = 0; i < k && kk == k; i++ )
+		{
+			INT a = i * s;
+			INT e = cscmin ( a + s, p );
+			lb[i] = -1;			//no rotation in the gap
+			if ( e - a < 2 )	continue;
+			INT t = ( d[i] - d[i + 1] + 2 * b * ( a + e ) ) / ( 4 * b );
+			for ( INT r = t; r <= t + 1; r++ )
+			{
+				INT rr = cscmax ( a + 1, cscmin ( r, e - 1 ) );
+				INT f = cscmax ( d[i] - 2 * b * ( rr - a ), d[i + 1] - 2 * b * ( e - rr ) );
+				if ( f < 0 )	f = 0;
+				if ( lb[i] < 0 || f < lb[i] )	lb[i] = f;
+			}
+			order . push_back ( i );
+		}
+		sort ( order . begin (), order . end (), [&] ( INT u, INT v ) { return ( lb[u] < lb[v] || ( lb[u] == lb[v] && u < v ) ); } );
+
+		/* Fine: scan every rotation of the gaps with the lowest lower bounds that may beat the minimum */
+		INT fine = 0;
+		INT scanned = 0;
+		struct TScan sc;
+		if ( ! order . empty () && lb[order[0]] < min_dist && ! deadline_passed () )
+		{
+			if ( ! scan_init ( &sc, xp, yp, m, n, q, b, sigma, xind, xmf ) )
+				return ( 0 );
+			for ( INT g : order )
+			{
+				if ( scanned == C || lb[g] >= min_dist || deadline_passed () )	break;
+				INT a = g * s;
+				INT e = cscmin ( a + s, p );
+				scan_seek ( &sc, a );
+				INT r;
+				for ( r = a + 1; r < e; r++ )
+				{
+					if ( ( r & 1023 ) == 0 && deadline_passed () )	break;
+					INT dist = scan_next ( &sc );
+					if ( top )	topk_push ( top, dist, r );
+					if ( dist < min_dist || ( dist == min_dist && r < rot ) )
+					{
+						min_dist = dist;
+						rot = r;
+					}
+				}
+				fine += r - a - 1;
+				if ( r < e )	break;
+				lb[g] = -1;
+				scanned++;
+			}
+			scan_free ( &sc );
+		}
+
+		exact = ( kk == k );
+		for ( INT g : order )
+			if ( lb[g] >= 0 && lb[g] < min_dist )	exact = 0;
+		fprintf ( stderr, " Coarse-to-fine search evaluated %ld coarse and %ld fine rotations of %ld in %lf secs.\n",
+				( long ) kk, ( long ) fine, ( long ) p, gettime() - start );
+	}
+	fprintf ( stderr, " The minimum %s the one of the exhaustive scan.\n", exact ? "is provably" : "may not be" );
+
+	( * distance ) = ( unsigned int ) min_dist;
+	( * rotation ) = ( unsigned int ) rot;
+
+	free ( xp );
+	free ( yp );
 	free ( xind );
-	free ( xmf );	
+	free ( xmf );
 	free ( yind );
-	free ( ymf );	
-	free ( xxy );	
-	free ( invSA );
+	free ( ymf );
+	free ( cnt );
+	free ( d );
+	free ( lb );
+	return ( 1 );
+}
+
+/*
+Compares x against y and y against x on a single ranking of xxyy: the two
+Step 3 scans have their own partitions but advance in lockstep over the
+shared x' and y'. rotation[0] and distance[0] are the best rotation of x
+against y, rotation[1] and distance[1] those of y against x.
+*/
+unsigned int sacsc_both_directions (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance )
+{
+	INT m = strlen ( ( char * ) x );
+	INT n = strlen ( ( char * ) y );
+	INT q = sw . q;
+
+	/* xxyy is xxy with a second copy of y, ranked as a y of length 2n */
+	unsigned char * yy = ( unsigned char * ) calloc ( n + n + 1, sizeof ( unsigned char ) );
+	if ( yy == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for yy.\n" );
+                return ( 0 );
+	}
+	memcpy ( yy, y, n );
+	memcpy ( yy + n, y, n );
+
+	INT * xp = ( INT * ) calloc( ( m + m - q + 1 ) , sizeof( INT ) ); // x'
+	INT * yp = ( INT * ) calloc( ( n + n - q + 1 ) , sizeof( INT ) ); // y'
+	if ( xp == NULL || yp == NULL )
+	{
+                fprintf(stderr, " Error: Cannot allocate memory for x' and y'.\n" );
+                return ( 0 );
+	}
+	INT sigma = rank_xxy ( x, yy, m, n + n, q, xp, yp, sw . T );
+	free ( yy );
+	if ( sigma < 0 )
+		return ( 0 );
+
+	struct TScan s[2];
+	if ( ! scan_init ( &s[0], xp, yp, m, n, q, m / sw . l, sigma ) || ! scan_init ( &s[1], yp, xp, n, m, q, n / sw . l, sigma ) )
+		return ( 0 );
+
+	/* Each scan stops after the distinct rotations of its sequence */
+	INT min_dist[2] = { s[0] . dist, s[1] . dist };
+	INT rot[2] = { 0, 0 };
+	INT period[2] = { circular_period ( xp, m ), circular_period ( yp, n ) };
+	INT mn = cscmax ( period[0], period[1] );
+	for ( INT i = 1; i < mn; i++ )
+	{
+		for ( unsigned int d = 0; d < 2; d++ )
+		{
+			if ( i >= period[d] )	continue;
+			INT dist = scan_next ( &s[d] );
+			if ( dist < min_dist[d] )
+			{
+				rot[d] = i;
+				min_dist[d] = dist;
+			}
+		}
+	}
+	for ( unsigned int d = 0; d < 2; d++ )
+	{
+		rotation[d] = ( unsigned int ) rot[d];
+		distance[d] = ( unsigned int ) min_dist[d];
+		scan_free ( &s[d] );
+	}
+
+	free ( xp );
+	free ( yp );
+	return ( 1 );
+}
+
+/*
+Runs saCSC for every (q, l) pair of sw . qs x sw . ls on a single SA/LCP index
+of xxy and writes one result row per pair to out_fd
+*/
+unsigned int sacsc_sweep (  unsigned char * x, unsigned char * y, struct TSwitch  sw, FILE * out_fd )
+{
+	INT * SA;
+	INT * LCP;
+	unsigned char * xxy;
+	INT m = strlen ( ( char * ) x );
+	INT n = strlen ( ( char * ) y );
+	unsigned int nq = sw . nq;
+	unsigned int nl = sw . nl;
+
+	if ( ! build_xxy_index ( x, y, m, n, &xxy, &SA, &LCP ) )
+		return ( 0 );
+
+	/* Rank once per q: the LCP array holds the q-gram ranking for every q */
+	INT ** xp = ( INT ** ) calloc ( nq, sizeof ( INT * ) );
+	INT ** yp = ( INT ** ) calloc ( nq, sizeof ( INT * ) );
+	INT * sigma = ( INT * ) calloc ( nq, sizeof ( INT ) );
+	for ( unsigned int i = 0; i < nq; i++ )
+	{
+		INT q = sw . qs[i];
+		if ( q < 1 || q > m || q > n )	continue;
+		xp[i] = ( INT * ) calloc( ( m + m - q + 1 ) , sizeof( INT ) );
+		yp[i] = ( INT * ) calloc( ( n - q + 1 ) , sizeof( INT ) );
+		sigma[i] = qgram_ranking ( SA, LCP, m, n, q, xp[i], yp[i] );
+	}
+	free ( xxy );
 	free ( SA );
 	free ( LCP );
-	for ( INT i = 0; i < b; i++ )	free ( diff[i] );
-	free ( diff );
+
+	/* Run the Step 3 scans of all the (q, l) pairs on sw . T threads */
+	unsigned int num = nq * nl;
+	TPOcc * res = ( TPOcc * ) calloc ( num, sizeof ( TPOcc ) );
+	unsigned char * valid = ( unsigned char * ) calloc ( num, sizeof ( unsigned char ) );
+	std::atomic<unsigned int> next ( 0 );
+	auto worker = [&] ()
+	{
+		unsigned int t;
+		while ( ( t = next ++ ) < num )
+		{
+			INT q = sw . qs[t / nl];
+			INT l = sw . ls[t % nl];
+			if ( xp[t / nl] == NULL || l < 1 || q >= l || l > m - q + 1 || l > n - q + 1 )	continue;
+			valid[t] = blockwise_scan ( xp[t / nl], yp[t / nl], m, n, q, m / l, sigma[t / nl], &res[t] . rot, &res[t] . err );
+		}
+	};
+	std::vector<std::thread> threads;
+	for ( unsigned int i = 1; i < sw . T && i < num; i++ )	threads . push_back ( std::thread ( worker ) );
+	worker ();
+	for ( auto & t : threads )	t . join ();
+
+	fprintf ( out_fd, "#q\tl\tblocks\tdistance\trotation\n" );
+	for ( unsigned int t = 0; t < num; t++ )
+	{
+		unsigned int q = sw . qs[t / nl];
+		unsigned int l = sw . ls[t % nl];
+		if ( ! valid[t] )
+		{
+        		fprintf( stderr, " Warning: Skipping illegal q-gram length %u with block length %u.\n", q, l );
+			continue;
+		}
+		fprintf ( out_fd, "%u\t%u\t%u\t%u\t%u\n", q, l, ( unsigned int ) ( m / l ), res[t] . err, res[t] . rot );
+	}
+
+	for ( unsigned int i = 0; i < nq; i++ )
+	{
+		free ( xp[i] );
+		free ( yp[i] );
+	}
+	free ( xp );
+	free ( yp );
+	free ( sigma );
+	free ( res );
+	free ( valid );
 	return ( 1 );
 }
 
@@ -16,6 +16,9 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **/
 
+#ifndef __SACSC__
+#define __SACSC__
+
 #ifdef _USE_64
 typedef int64_t INT;
 #endif
@@ -24,7 +27,84 @@ typedef int64_t INT;
 typedef int32_t INT;
 #endif
 
+struct TScan
+{
+	INT *                xp;                     // the ranks of the q-grams of xx (x')
+	INT *                yp;                     // the ranks of the q-grams of y (y')
+	INT                  m;                      // the length of x
+	INT                  b;                      // the number of blocks
+	INT                  sigma;                  // the largest rank
+	INT *                xind;                   // the starting position of each block of x'
+	INT *                xmf;                    // the number of q-grams in each block of x'
+	INT *                yind;                   // the starting position of each block of y'
+	INT *                ymf;                    // the number of q-grams in each block of y'
+	INT **               diff;                   // the per block difference of q-gram counts
+	INT *                D;                      // the per block q-gram distance
+	INT                  rot;                    // the rotation D refers to
+	INT                  dist;                   // the blockwise q-gram distance of rot
+	unsigned int         own_xind;               // whether xind and xmf were allocated by the scan
+};
+
+struct TIndex
+{
+	void *               map;                    // the memory-mapped index file
+	size_t               size;                   // the size of the index file
+	INT                  m;                      // the length of the reference x
+	INT                  q;                      // the q-gram length
+	INT                  l;                      // the block length
+	INT                  b;                      // the number of blocks
+	INT                  sigma;                  // the largest rank in x'
+	unsigned char *      x_id;                   // the reference id
+	unsigned char *      x;                      // the reference sequence
+	INT *                SA;                     // the circular q-gram positions of x in lexicographic order
+	INT *                xp;                     // the ranks of the q-grams of xx (x')
+	INT *                xind;                   // the starting position of each block of x'
+	INT *                xmf;                    // the number of q-grams in each block of x'
+};
+
+struct TCollection
+{
+	INT                  num;                    // the number of sequences
+	INT                  q;                      // the q-gram length
+	INT *                start;                  // the position of each sequence in the text and in R
+	INT *                len;                    // the length of each sequence
+	INT *                R;                      // the global rank of every circular q-gram
+	INT                  sigma;                  // the largest global rank
+};
+
 unsigned int LCParray ( unsigned char *text, INT n, INT * SA, INT * ISA, INT * LCP );
+unsigned int suffix_array_lcp ( unsigned char * text, INT n, INT * SA, INT * LCP );
+INT rank_xxy ( unsigned char * x, unsigned char * y, INT m, INT n, INT q, INT * xp, INT * yp, unsigned int threads );
+unsigned int build_xxy_index ( unsigned char * x, unsigned char * y, INT m, INT n, unsigned char ** xxy, INT ** SA, INT ** LCP );
+INT qgram_ranking ( INT * SA, INT * LCP, INT m, INT n, INT q, INT * xp, INT * yp );
+INT qgram_ranking_parallel ( unsigned char * xxy, INT m, INT n, INT q, INT * xp, INT * yp, unsigned int threads );
+unsigned int sacsc_tune ( unsigned char * x, unsigned char * y, struct TSwitch * sw );
+INT fft_candidates ( unsigned char * x, INT m, unsigned char * y, INT n, INT p, INT c, INT * cand );
 void partitioning ( INT i, INT j, INT f, INT m, INT * mf, INT * ind );
-unsigned int circular_sequence_comparison (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance );
-unsigned int sacsc_refinement (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance );
+unsigned int scan_init ( struct TScan * s, INT * xp, INT * yp, INT m, INT n, INT q, INT b, INT sigma, INT * xind = NULL, INT * xmf = NULL );
+INT scan_next ( struct TScan * s );
+INT scan_seek ( struct TScan * s, INT r );
+void scan_next_multi ( struct TScan * s, INT k );
+void scan_free ( struct TScan * s );
+INT rotation_distance ( INT * xp, INT * yp, INT b, INT * xind, INT * xmf, INT * yind, INT * ymf, INT r, INT * cnt );
+unsigned int blockwise_scan ( INT * xp, INT * yp, INT m, INT n, INT q, INT b, INT sigma, unsigned int * rotation, unsigned int * distance, struct TTopK * top = NULL, struct TProfile * profile = NULL, INT * xind = NULL, INT * xmf = NULL );
+unsigned int circular_sequence_comparison (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance, struct TTopK * top = NULL, struct TProfile * profile = NULL );
+unsigned int sacsc_small_comparison (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance, struct TTopK * top = NULL, struct TProfile * profile = NULL );
+unsigned int sacsc_shortlist_comparison (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance, struct TTopK * top = NULL );
+unsigned int sacsc_coarse_to_fine (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance, struct TTopK * top = NULL );
+unsigned int sacsc_both_directions (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance );
+unsigned int sacsc_refinement (  unsigned char * x, unsigned char * y, struct TSwitch  sw, unsigned int * rotation, unsigned int * distance, struct TTopK * top = NULL, struct TProfile * profile = NULL );
+unsigned int sacsc_sweep (  unsigned char * x, unsigned char * y, struct TSwitch  sw, FILE * out_fd );
+unsigned int sacsc_build_index ( unsigned char * x, unsigned char * x_id, struct TSwitch  sw, char * filename );
+unsigned int sacsc_load_index ( char * filename, struct TIndex * idx );
+void sacsc_unload_index ( struct TIndex * idx );
+unsigned int sacsc_indexed_comparison ( struct TIndex * idx, unsigned char * y, unsigned int * rotation, unsigned int * distance, struct TTopK * top = NULL, struct TProfile * profile = NULL );
+unsigned int sacsc_build_collection ( unsigned char ** seq, INT num, INT q, struct TCollection * c );
+void sacsc_free_collection ( struct TCollection * c );
+unsigned int sacsc_collection_comparison ( struct TCollection * c, INT i, INT j, INT l, INT * local, unsigned int * rotation, unsigned int * distance );
+unsigned int sacsc_multi_query ( unsigned char ** seq, unsigned char ** seq_id, unsigned int num_seqs, struct TSwitch  sw, FILE * out_fd );
+unsigned int sacsc_all_vs_all ( unsigned char ** seq, unsigned char ** seq_id, unsigned int num_seqs, struct TSwitch  sw, FILE * out_fd );
+unsigned int sacsc_lane_comparisons ( struct TCollection * c, INT * xs, INT * ys, INT num, INT l, unsigned int threads, TPOcc * res, unsigned char * valid );
+unsigned int sacsc_pairs_list ( unsigned char ** seq, unsigned char ** seq_id, unsigned int num_seqs, struct TSwitch  sw, FILE * out_fd );
+
+#endif
@@ -0,0 +1,400 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "seqpack.h"
+
+#define PACK_BUFFER_SIZE        1048576
+
+static const char * pack_letters[] = { "ACGT", "ACGU", "ARNDCQEGHILKMFPSTWYVX" };	//the coded letters of DNA, RNA and PROT
+
+static inline unsigned int pack_width ( uint64_t coding )
+{
+	return ( coding == PACK_PROT ) ? 5 : 2;
+}
+
+static inline unsigned int pack_per_word ( uint64_t coding )
+{
+	return 64 / pack_width ( coding );
+}
+
+static inline uint64_t pack_num_words ( uint64_t coding, uint64_t length )
+{
+	return ( length + pack_per_word ( coding ) - 1 ) / pack_per_word ( coding );
+}
+
+/*
+Returns 1 if filename starts with the magic of a packed container
+*/
+int pack_is_packed ( char * filename )
+{
+	char magic[8];
+	FILE * fd;
+
+	if ( ! ( fd = fopen ( filename, "rb" ) ) )
+		return ( 0 );
+	int ret = ( fread ( magic, sizeof ( char ), 8, fd ) == 8 && memcmp ( magic, PACK_MAGIC, 8 ) == 0 );
+	fclose ( fd );
+	return ( ret );
+}
+
+static int pack_write ( FILE * fd, const void * data, size_t size, uint64_t * off )
+{
+	static const char zero[8] = { 0 };
+
+	if ( fwrite ( data, 1, size, fd ) != size )	return ( 0 );
+	( * off ) += size;
+	if ( ( * off ) % 8 )	//keep every section 8-byte aligned
+	{
+		size_t pad = 8 - ( * off ) % 8;
+		if ( fwrite ( zero, 1, pad, fd ) != pad )	return ( 0 );
+		( * off ) += pad;
+	}
+	return ( 1 );
+}
+
+/*
+Converts the (Multi)FASTA file input_filename into the packed container output_filename.
+Letters outside alphabet are rejected.
+*/
+int pack_fasta ( char * input_filename, char * output_filename, char * alphabet, int coding )
+{
+	FILE * in_fd;
+	FILE * out_fd;
+	int code[256];
+	const char * letters = pack_letters[coding];
+	unsigned int width = pack_width ( coding );
+	unsigned int per_word = pack_per_word ( coding );
+
+	for ( int i = 0; i < 256; i++ )	code[i] = -1;
+	for ( int i = 0; letters[i]; i++ )	code[( unsigned char ) letters[i]] = i;
+
+	if ( ! ( in_fd = fopen ( input_filename, "r" ) ) )
+	{
+		fprintf ( stderr, " Error: Cannot open file %s!\n", input_filename );
+		return ( 0 );
+	}
+	if ( ! ( out_fd = fopen ( output_filename, "wb" ) ) )
+	{
+		fprintf ( stderr, " Error: Cannot open file %s!\n", output_filename );
+		return ( 0 );
+	}
+	setvbuf ( in_fd, NULL, _IOFBF, PACK_BUFFER_SIZE );
+	setvbuf ( out_fd, NULL, _IOFBF, PACK_BUFFER_SIZE );
+
+	struct TPackHeader header;
+	memset ( &header, 0, sizeof ( header ) );
+	memcpy ( header . magic, PACK_MAGIC, 8 );
+	header . version = PACK_VERSION;
+	header . coding = coding;
+
+	uint64_t off = 0;
+	pack_write ( out_fd, &header, sizeof ( header ), &off );	//rewritten at the end
+
+	struct TPackRecord * rec = NULL;
+	uint64_t max_rec = 0;
+	char * ids = NULL;
+	uint64_t ids_size = 0;
+	uint64_t max_ids = 0;
+	uint64_t * words = NULL;
+	uint64_t max_words = 0;
+	struct TPackException * exc = NULL;
+	uint64_t max_exc = 0;
+
+	int c = fgetc ( in_fd );
+	while ( c != EOF )
+	{
+		if ( c != '>' )
+		{
+			fprintf ( stderr, " Error: input file %s is not in FASTA format!\n", input_filename );
+			return ( 0 );
+		}
+
+		/* The id goes to the string table */
+		uint64_t id_offset = ids_size;
+		while ( ( c = fgetc ( in_fd ) ) != EOF && c != '\n' )
+		{
+			if ( ids_size + 1 >= max_ids )
+			{
+				max_ids += PACK_BUFFER_SIZE;
+				ids = ( char * ) realloc ( ids, max_ids );
+			}
+			ids[ids_size++] = c;
+		}
+		if ( ids_size + 1 >= max_ids )
+		{
+			max_ids += PACK_BUFFER_SIZE;
+			ids = ( char * ) realloc ( ids, max_ids );
+		}
+		ids[ids_size++] = '\0';
+
+		/* The letters go to the packed words or to the exception runs */
+		uint64_t len = 0;
+		uint64_t num_exc = 0;
+		while ( ( c = fgetc ( in_fd ) ) != EOF && c != '>' )
+		{
+			if ( c == '\n' || c == ' ' || c == '\r' ) continue;
+
+			c = toupper ( c );
+			if ( ! strchr ( alphabet, c ) )
+			{
+				fprintf ( stderr, " Error: input file %s contains an unexpected character %c!\n", input_filename, c );
+				return ( 0 );
+			}
+
+			if ( len / per_word >= max_words )
+			{
+				max_words += PACK_BUFFER_SIZE;
+				words = ( uint64_t * ) realloc ( words, max_words * sizeof ( uint64_t ) );
+			}
+			if ( len % per_word == 0 )	words[len / per_word] = 0;
+
+			if ( code[c] >= 0 )
+			{
+				words[len / per_word] |= ( uint64_t ) code[c] << ( width * ( len % per_word ) );
+			}
+			else if ( num_exc > 0 && exc[num_exc - 1] . c == ( uint32_t ) c && exc[num_exc - 1] . pos + exc[num_exc - 1] . len == len )
+			{
+				exc[num_exc - 1] . len++;
+			}
+			else
+			{
+				if ( num_exc >= max_exc )
+				{
+					max_exc += PACK_BUFFER_SIZE;
+					exc = ( struct TPackException * ) realloc ( exc, max_exc * sizeof ( struct TPackException ) );
+				}
+				exc[num_exc] . pos = len;
+				exc[num_exc] . len = 1;
+				exc[num_exc] . c = c;
+				num_exc++;
+			}
+			len++;
+		}
+
+		if ( len == 0 )
+		{
+			fprintf ( stderr, " Omitting empty sequence in file %s!\n", input_filename );
+			ids_size = id_offset;
+			continue;
+		}
+
+		if ( header . num_seqs >= max_rec )
+		{
+			max_rec += PACK_BUFFER_SIZE;
+			rec = ( struct TPackRecord * ) realloc ( rec, max_rec * sizeof ( struct TPackRecord ) );
+		}
+		struct TPackRecord * r = &rec[header . num_seqs++];
+		r -> length = len;
+		r -> num_exc = num_exc;
+		r -> id_offset = id_offset;
+		r -> data_offset = off;
+		pack_write ( out_fd, words, pack_num_words ( coding, len ) * sizeof ( uint64_t ), &off );
+		r -> exc_offset = off;
+		pack_write ( out_fd, exc, num_exc * sizeof ( struct TPackException ), &off );
+	}
+
+	header . rec_offset = off;
+	pack_write ( out_fd, rec, header . num_seqs * sizeof ( struct TPackRecord ), &off );
+	header . ids_offset = off;
+	header . ids_size = ids_size;
+	int ret = pack_write ( out_fd, ids, ids_size, &off );
+
+	fseek ( out_fd, 0, SEEK_SET );
+	ret = ret && fwrite ( &header, sizeof ( header ), 1, out_fd ) == 1;
+
+	free ( rec );
+	free ( ids );
+	free ( words );
+	free ( exc );
+	fclose ( in_fd );
+	if ( fclose ( out_fd ) || ! ret )
+	{
+		fprintf ( stderr, " Error: Cannot write file %s!\n", output_filename );
+		return ( 0 );
+	}
+	return ( 1 );
+}
+
+/* Unmaps a partly opened container and returns the failure of pack_open */
+static int pack_unmap ( struct TPack * p )
+{
+	munmap ( p -> map, p -> size );
+	p -> map = NULL;
+	return ( 0 );
+}
+
+/* Returns 1 if the num items of size bytes at the 8-byte aligned offset off lie within size bytes */
+static inline int pack_fits ( uint64_t size, uint64_t off, uint64_t num, uint64_t item )
+{
+	return ( off % 8 == 0 && off <= size && num <= ( size - off ) / item );
+}
+
+/*
+Returns 1 if record r only points inside the file: its packed words, its
+exception runs, which must be sorted and lie within the sequence, and its id.
+*/
+static int pack_record_valid ( struct TPack * p, struct TPackRecord * r )
+{
+	uint64_t coding = p -> header -> coding;
+	uint64_t num_words = r -> length / pack_per_word ( coding ) + ( r -> length % pack_per_word ( coding ) != 0 );
+
+	if ( ! pack_fits ( p -> size, r -> data_offset, num_words, sizeof ( uint64_t ) ) ||
+	     ! pack_fits ( p -> size, r -> exc_offset, r -> num_exc, sizeof ( struct TPackException ) ) ||
+	     r -> id_offset >= p -> header -> ids_size )
+		return ( 0 );
+
+	struct TPackException * exc = ( struct TPackException * ) ( ( char * ) p -> map + r -> exc_offset );
+	uint64_t end = 0;
+	for ( uint64_t j = 0; j < r -> num_exc; j++ )
+	{
+		if ( exc[j] . pos < end || exc[j] . pos > r -> length || exc[j] . len > r -> length - exc[j] . pos )
+			return ( 0 );
+		end = exc[j] . pos + exc[j] . len;
+	}
+	return ( 1 );
+}
+
+/*
+Memory-maps the packed container filename and checks that every record lies within it
+*/
+int pack_open ( char * filename, struct TPack * p )
+{
+	int fd;
+	struct stat st;
+
+	if ( ( fd = open ( filename, O_RDONLY ) ) < 0 || fstat ( fd, &st ) != 0 )
+	{
+		fprintf ( stderr, " Error: Cannot open file %s!\n", filename );
+		return ( 0 );
+	}
+	p -> size = st . st_size;
+	p -> map = mmap ( NULL, p -> size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close ( fd );
+	if ( p -> map == MAP_FAILED )
+	{
+		fprintf ( stderr, " Error: Cannot map file %s!\n", filename );
+		return ( 0 );
+	}
+
+	char * map = ( char * ) p -> map;
+	p -> header = ( struct TPackHeader * ) map;
+	if ( p -> size < sizeof ( struct TPackHeader ) || memcmp ( p -> header -> magic, PACK_MAGIC, 8 ) != 0 || p -> header -> version != PACK_VERSION )
+	{
+		fprintf ( stderr, " Error: %s is not a packed sequence file of version %d!\n", filename, PACK_VERSION );
+		return ( pack_unmap ( p ) );
+	}
+	if ( p -> header -> coding > PACK_PROT ||
+	     ! pack_fits ( p -> size, p -> header -> rec_offset, p -> header -> num_seqs, sizeof ( struct TPackRecord ) ) ||
+	     ! pack_fits ( p -> size, p -> header -> ids_offset, p -> header -> ids_size, 1 ) ||
+	     ( p -> header -> ids_size && map[p -> header -> ids_offset + p -> header -> ids_size - 1] != '\0' ) )
+	{
+		fprintf ( stderr, " Error: Packed sequence file %s is truncated!\n", filename );
+		return ( pack_unmap ( p ) );
+	}
+	p -> rec = ( struct TPackRecord * ) ( map + p -> header -> rec_offset );
+	p -> ids = map + p -> header -> ids_offset;
+	for ( uint64_t i = 0; i < p -> header -> num_seqs; i++ )
+	{
+		if ( ! pack_record_valid ( p, &p -> rec[i] ) )
+		{
+			fprintf ( stderr, " Error: Record %lu of packed sequence file %s lies outside the file!\n", ( unsigned long ) i, filename );
+			return ( pack_unmap ( p ) );
+		}
+	}
+	return ( 1 );
+}
+
+void pack_close ( struct TPack * p )
+{
+	munmap ( p -> map, p -> size );
+}
+
+uint64_t pack_num_seqs ( struct TPack * p )
+{
+	return ( p -> header -> num_seqs );
+}
+
+uint64_t pack_length ( struct TPack * p, uint64_t i )
+{
+	return ( p -> rec[i] . length );
+}
+
+char * pack_id ( struct TPack * p, uint64_t i )
+{
+	return ( p -> ids + p -> rec[i] . id_offset );
+}
+
+/*
+Returns the letter at position pos of sequence i
+*/
+unsigned char pack_char ( struct TPack * p, uint64_t i, uint64_t pos )
+{
+	struct TPackRecord * r = &p -> rec[i];
+	struct TPackException * exc = ( struct TPackException * ) ( ( char * ) p -> map + r -> exc_offset );
+	uint64_t coding = p -> header -> coding;
+
+	/* Binary search for the last run starting at or before pos */
+	uint64_t lo = 0;
+	uint64_t hi = r -> num_exc;
+	while ( lo < hi )
+	{
+		uint64_t mid = lo + ( hi - lo ) / 2;
+		if ( exc[mid] . pos <= pos )	lo = mid + 1;
+		else				hi = mid;
+	}
+	if ( lo > 0 && pos < exc[lo - 1] . pos + exc[lo - 1] . len )
+		return ( exc[lo - 1] . c );
+
+	uint64_t * words = ( uint64_t * ) ( ( char * ) p -> map + r -> data_offset );
+	unsigned int per_word = pack_per_word ( coding );
+	unsigned int width = pack_width ( coding );
+	return pack_letters[coding][( words[pos / per_word] >> ( width * ( pos % per_word ) ) ) & ( ( 1 << width ) - 1 )];
+}
+
+/*
+Decodes sequence i into seq, which must hold pack_length ( p, i ) + 1 letters
+*/
+void pack_decode ( struct TPack * p, uint64_t i, unsigned char * seq )
+{
+	struct TPackRecord * r = &p -> rec[i];
+	uint64_t coding = p -> header -> coding;
+	uint64_t * words = ( uint64_t * ) ( ( char * ) p -> map + r -> data_offset );
+	struct TPackException * exc = ( struct TPackException * ) ( ( char * ) p -> map + r -> exc_offset );
+	const char * letters = pack_letters[coding];
+	unsigned int per_word = pack_per_word ( coding );
+	unsigned int width = pack_width ( coding );
+	uint64_t mask = ( 1 << width ) - 1;
+
+	for ( uint64_t j = 0, pos = 0; pos < r -> length; j++ )
+	{
+		uint64_t w = words[j];
+		for ( unsigned int k = 0; k < per_word && pos < r -> length; k++, pos++, w >>= width )
+			seq[pos] = letters[w & mask];
+	}
+	for ( uint64_t j = 0; j < r -> num_exc; j++ )
+		memset ( seq + exc[j] . pos, exc[j] . c, exc[j] . len );
+	seq[r -> length] = '\0';
+}
@@ -0,0 +1,91 @@
+/**
+    CSC: Circular Sequence Comparison
+    Copyright (C) 2015 Solon P. Pissis, Ahmad Retha, Fatima Vayani
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef __SEQPACK__
+#define __SEQPACK__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+Packed sequence container. All the fields are little-endian 64-bit words
+unless stated otherwise and every section is 8-byte aligned:
+
+  header     TPackHeader
+  data       for each sequence, its packed words followed by its exception runs
+  records    num_seqs TPackRecord entries (the offset index)
+  ids        the null-terminated sequence ids (the header string table)
+
+Nucleotides are stored with 2 bits (A, C, G, T/U; 32 per word) and proteins
+with 5 bits (the letters of PROT; 12 per word). Any other letter, such as N
+or an IUPAC code, is stored as code 0 and listed in the exception runs.
+*/
+#define PACK_MAGIC              "CSCPACK"
+#define PACK_VERSION            1
+#define PACK_DNA                0
+#define PACK_RNA                1
+#define PACK_PROT               2
+
+struct TPackHeader
+{
+    char                 magic[8];               // PACK_MAGIC
+    uint64_t             version;                // PACK_VERSION
+    uint64_t             coding;                 // PACK_DNA, PACK_RNA or PACK_PROT
+    uint64_t             num_seqs;               // the number of sequences
+    uint64_t             rec_offset;             // the file offset of the records
+    uint64_t             ids_offset;             // the file offset of the ids
+    uint64_t             ids_size;               // the size of the ids in bytes
+    uint64_t             reserved;
+};
+
+struct TPackRecord
+{
+    uint64_t             length;                 // the length of the sequence
+    uint64_t             data_offset;            // the file offset of the packed words
+    uint64_t             exc_offset;             // the file offset of the exception runs
+    uint64_t             num_exc;                // the number of exception runs
+    uint64_t             id_offset;              // the offset of the id in the ids
+};
+
+struct TPackException
+{
+    uint64_t             pos;                    // the first position of the run
+    uint32_t             len;                    // the length of the run
+    uint32_t             c;                      // the letter of the run
+};
+
+struct TPack
+{
+    void *               map;                    // the memory-mapped file
+    size_t               size;                   // the size of the file
+    struct TPackHeader * header;
+    struct TPackRecord * rec;
+    char *               ids;
+};
+
+int pack_is_packed ( char * filename );
+int pack_fasta ( char * input_filename, char * output_filename, char * alphabet, int coding );
+int pack_open ( char * filename, struct TPack * p );
+void pack_close ( struct TPack * p );
+uint64_t pack_num_seqs ( struct TPack * p );
+uint64_t pack_length ( struct TPack * p, uint64_t i );
+char * pack_id ( struct TPack * p, uint64_t i );
+unsigned char pack_char ( struct TPack * p, uint64_t i, uint64_t pos );
+void pack_decode ( struct TPack * p, uint64_t i, unsigned char * seq );
+
+#endif
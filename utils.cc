@@ -26,7 +26,9 @@
 #include <assert.h>
 #include <limits.h>
 #include <sys/time.h>
+#include <atomic>
 #include "csc.h"
+#include "seqpack.h"
 
 
 static struct option long_options[] =
@@ -40,11 +42,56 @@ static struct option long_options[] =
    { "blocks-refine",           optional_argument, NULL, 'P' },
    { "gap-open-penalty",        optional_argument, NULL, 'O' },
    { "gap-extend-penalty",      optional_argument, NULL, 'E' },
+   { "top-k",                   required_argument, NULL, 'k' },
+   { "profile-file",            required_argument, NULL, 'R' },
+   { "threads",                 required_argument, NULL, 'T' },
+   { "build-index",             required_argument, NULL, 'B' },
+   { "index-file",              required_argument, NULL, 'X' },
+   { "pack",                    required_argument, NULL, 'Z' },
+   { "batch",                   no_argument,       NULL, 'b' },
+   { "all-vs-all",              no_argument,       NULL, 'A' },
+   { "both-directions",         no_argument,       NULL, 'D' },
+   { "multi-query",             required_argument, NULL, 'M' },
+   { "pairs-file",              required_argument, NULL, 'p' },
+   { "anchor-length",           required_argument, NULL, 'K' },
+   { "fft-candidates",          required_argument, NULL, 'F' },
+   { "stride",                  required_argument, NULL, 'S' },
+   { "candidates",              required_argument, NULL, 'C' },
+   { "time-limit",              required_argument, NULL, 't' },
+   { "memory-limit",            required_argument, NULL, 'U' },
+   { "allow-heuristic",         no_argument,       NULL, 'H' },
    { "help",                    no_argument,       NULL, 'h' },
    { NULL,                      0,                 NULL, 0   }
 };
 
 
+/*
+Parse a comma-separated list of integers, e.g. `4,5,6'; returns the number of values
+*/
+static unsigned int parse_list ( char * str, unsigned int ** list )
+{
+   unsigned int num = 0;
+   char * ep;
+
+   free ( * list );
+   ( * list ) = NULL;
+   do
+    {
+      long val = strtol ( str, &ep, 10 );
+      if ( str == ep || val < 0 )
+        {
+          return ( 0 );
+        }
+      ( * list ) = ( unsigned int * ) realloc ( ( * list ), ( num + 1 ) * sizeof ( unsigned int ) );
+      ( * list )[num ++] = val;
+      str = ep + 1;
+    }
+   while ( * ep == ',' );
+
+   return ( * ep == '\0' ) ? num : 0;
+}
+
+
 /* 
 Decode the input switches 
 */
@@ -66,9 +113,31 @@ int decode_switches ( int argc, char * argv [], struct TSwitch * sw )
    sw -> P                              = 0.0;
    sw -> O                              = 10.0;
    sw -> E                              = 0.5;
+   sw -> k                              = 1;
+   sw -> profile_filename               = NULL;
+   sw -> qs                             = NULL;
+   sw -> nq                             = 0;
+   sw -> ls                             = NULL;
+   sw -> nl                             = 0;
+   sw -> T                              = 1;
+   sw -> build_index_filename           = NULL;
+   sw -> index_filename                 = NULL;
+   sw -> pack_filename                  = NULL;
+   sw -> batch                          = 0;
+   sw -> all_vs_all                     = 0;
+   sw -> both                           = 0;
+   sw -> multi                          = 0;
+   sw -> pairs_filename                 = NULL;
+   sw -> anchor                         = 0;
+   sw -> fft                            = 0;
+   sw -> stride                         = 0;
+   sw -> candidates                     = 0;
+   sw -> time_limit                     = 0.0;
+   sw -> memory_limit                   = 0.0;
+   sw -> heuristic                      = 0;
    args = 0;
 
-   while ( ( opt = getopt_long ( argc, argv, "m:a:i:o:q:l:P:O:E:h", long_options, &oi ) ) != - 1 )
+   while ( ( opt = getopt_long ( argc, argv, "m:a:i:o:q:l:P:O:E:k:R:T:B:X:Z:bADM:p:K:F:S:C:t:U:Hh", long_options, &oi ) ) != - 1 )
     {
       switch ( opt )
        {
@@ -97,22 +166,20 @@ int decode_switches ( int argc, char * argv [], struct TSwitch * sw )
            break;
 
          case 'q':
-           val = strtol ( optarg, &ep, 10 );
-           if ( optarg == ep )
+           if ( ( sw -> nq = parse_list ( optarg, &sw -> qs ) ) == 0 )
             {
               return ( 0 );
             }
-           sw -> q = val;
+           sw -> q = sw -> qs[0];
            args ++;
            break;
 
          case 'l':
-           val = strtol ( optarg, &ep, 10 );
-           if ( optarg == ep )
+           if ( ( sw -> nl = parse_list ( optarg, &sw -> ls ) ) == 0 )
             {
               return ( 0 );
             }
-           sw -> l = val;
+           sw -> l = sw -> ls[0];
            args ++;
            break;
 
@@ -143,12 +210,134 @@ int decode_switches ( int argc, char * argv [], struct TSwitch * sw )
            sw -> E = abs ( val );
            break;
 
+         case 'k':
+           val = strtol ( optarg, &ep, 10 );
+           if ( optarg == ep || val < 1 )
+            {
+              return ( 0 );
+            }
+           sw -> k = val;
+           break;
+
+         case 'T':
+           val = strtol ( optarg, &ep, 10 );
+           if ( optarg == ep || val < 1 )
+            {
+              return ( 0 );
+            }
+           sw -> T = val;
+           break;
+
+         case 'B':
+           sw -> build_index_filename = ( char * ) malloc ( ( strlen ( optarg ) + 1 ) * sizeof ( char ) );
+           strcpy ( sw -> build_index_filename, optarg );
+           break;
+
+         case 'X':
+           sw -> index_filename = ( char * ) malloc ( ( strlen ( optarg ) + 1 ) * sizeof ( char ) );
+           strcpy ( sw -> index_filename, optarg );
+           break;
+
+         case 'Z':
+           sw -> pack_filename = ( char * ) malloc ( ( strlen ( optarg ) + 1 ) * sizeof ( char ) );
+           strcpy ( sw -> pack_filename, optarg );
+           break;
+
+         case 'b':
+           sw -> batch = 1;
+           break;
+
+         case 'A':
+           sw -> all_vs_all = 1;
+           break;
+
+         case 'D':
+           sw -> both = 1;
+           break;
+
+         case 'M':
+           val = strtol ( optarg, &ep, 10 );
+           if ( optarg == ep || val < 1 )
+            {
+              return ( 0 );
+            }
+           sw -> multi = val;
+           break;
+
+         case 'p':
+           sw -> pairs_filename = ( char * ) malloc ( ( strlen ( optarg ) + 1 ) * sizeof ( char ) );
+           strcpy ( sw -> pairs_filename, optarg );
+           break;
+
+         case 'K':
+           val = strtol ( optarg, &ep, 10 );
+           if ( optarg == ep || val < 1 )
+            {
+              return ( 0 );
+            }
+           sw -> anchor = val;
+           break;
+
+         case 'F':
+           val = strtol ( optarg, &ep, 10 );
+           if ( optarg == ep || val < 1 )
+            {
+              return ( 0 );
+            }
+           sw -> fft = val;
+           break;
+
+         case 'S':
+           val = strtol ( optarg, &ep, 10 );
+           if ( optarg == ep || val < 0 )
+            {
+              return ( 0 );
+            }
+           sw -> stride = val ? val : STRIDE_AUTO;
+           break;
+
+         case 'C':
+           val = strtol ( optarg, &ep, 10 );
+           if ( optarg == ep || val < 1 )
+            {
+              return ( 0 );
+            }
+           sw -> candidates = val;
+           break;
+
+         case 't':
+           val = strtod ( optarg, &ep );
+           if ( optarg == ep || val <= 0 )
+            {
+              return ( 0 );
+            }
+           sw -> time_limit = val;
+           break;
+
+         case 'U':
+           val = strtod ( optarg, &ep );
+           if ( optarg == ep || val <= 0 )
+            {
+              return ( 0 );
+            }
+           sw -> memory_limit = val;
+           break;
+
+         case 'H':
+           sw -> heuristic = 1;
+           break;
+
+         case 'R':
+           sw -> profile_filename = ( char * ) malloc ( ( strlen ( optarg ) + 1 ) * sizeof ( char ) );
+           strcpy ( sw -> profile_filename, optarg );
+           break;
+
          case 'h':
            return ( 0 );
        }
     }
 
-   if ( args < 6 )
+   if ( args < 6 && ! ( sw -> pack_filename && sw -> alphabet && sw -> input_filename ) )
      {
        usage ();
        exit ( 1 );
@@ -166,13 +355,25 @@ void usage ( void )
    fprintf ( stdout, " Usage: csc <options>\n" );
    fprintf ( stdout, " Standard (Mandatory):\n" );
    fprintf ( stdout, "  -m, --method              <str>     `hCSC' for heuristic, `nCSC' for naive\n"
-                     "                                      and `saCSC' for suffix-array algorithm. \n" );
-   fprintf ( stdout, "  -a, --alphabet            <str>     `DNA' or `RNA' for nucleotide sequences or\n"
-                     "                                      `PROT' for protein  sequences. \n" );
-   fprintf ( stdout, "  -i, --input-file          <str>     (Multi)FASTA input filename.\n" );
+                     "                                      and `saCSC' for suffix-array algorithm,\n"
+                     "                                      or `auto' to choose the fastest engine\n"
+                     "                                      predicted for the input (see -U, -H). \n" );
+   fprintf ( stdout, "  -a, --alphabet            <str>     `DNA' or `RNA' for nucleotide sequences,\n"
+                     "                                      `IUPAC' for ambiguous nucleotide sequences\n"
+                     "                                      or `PROT' for protein  sequences. \n" );
+   fprintf ( stdout, "  -i, --input-file          <str>     (Multi)FASTA or packed input filename.\n" );
    fprintf ( stdout, "  -o, --output-file         <str>     Output filename for the rotated sequences.\n" );
    fprintf ( stdout, "  -q, --q-length            <int>     The q-gram length.\n");
    fprintf ( stdout, "  -l, --block-length        <int>     The length of each block.\n");
+   fprintf ( stdout, "                                      A q or l of 0 is tuned on the q-gram\n"
+                     "                                      statistics of the pair to tell the\n"
+                     "                                      q-grams apart with diff tables fitting\n"
+                     "                                      -U, or 512 MB when -U is not given.\n");
+   fprintf ( stdout, "                                      With saCSC, comma-separated lists of q\n"
+                     "                                      and l values (e.g. -q 4,5,6 -l 25,50)\n"
+                     "                                      run a sweep over all (q, l) pairs on a\n"
+                     "                                      single index and write one row per pair\n"
+                     "                                      to the output file.\n");
    fprintf ( stdout, " Extra (Optional and only to be used with saCSC):\n" );
    fprintf ( stdout, "  -P, --blocks-refine       <float>   The number of blocks of length l to use to\n"
                      "                                      refine the results of saCSC by (e.g. 1.0)\n" );
@@ -190,6 +391,92 @@ void usage ( void )
                      "                                      residue in the gap. This is how long gaps\n"
                      "                                      are penalized. Floating point number from\n"
                      "                                      0.0  to  10.0.  (default:  0.5)\n" );
+   fprintf ( stdout, " Extra (Optional):\n" );
+   fprintf ( stdout, "  -k, --top-k               <int>     Report the k best rotations found during\n"
+                     "                                      the scan (default: 1).\n" );
+   fprintf ( stdout, "  -R, --profile-file        <str>     Write the distance of every scanned\n"
+                     "                                      rotation to this run-length encoded\n"
+                     "                                      binary file (saCSC and nCSC only).\n" );
+   fprintf ( stdout, "  -B, --build-index         <str>     Build the saCSC index of the first input\n"
+                     "                                      sequence for the given q and l, store it\n"
+                     "                                      in this file and exit.\n" );
+   fprintf ( stdout, "  -X, --index-file          <str>     Compare the reference of this index file\n"
+                     "                                      (built with -B) against the first input\n"
+                     "                                      sequence with saCSC.\n" );
+   fprintf ( stdout, "  -Z, --pack                <str>     Convert the (Multi)FASTA input file into\n"
+                     "                                      a packed sequence file and exit; only -a\n"
+                     "                                      and -i are needed. Packed files are read\n"
+                     "                                      natively by -i.\n" );
+   fprintf ( stdout, "  -b, --batch               <void>    Compare every consecutive pair of input\n"
+                     "                                      sequences (1st with 2nd, 3rd with 4th,\n"
+                     "                                      ...) in a pipeline of -T workers; the\n"
+                     "                                      rotated pairs go to the output file and\n"
+                     "                                      one result row per pair to stdout.\n" );
+   fprintf ( stdout, "  -A, --all-vs-all          <void>    Compare every ordered pair of input\n"
+                     "                                      sequences with saCSC on one collection\n"
+                     "                                      index and write one row per pair to the\n"
+                     "                                      output file.\n" );
+   fprintf ( stdout, "  -D, --both-directions     <void>    Also compare y against x with saCSC on the\n"
+                     "                                      same index; the output file holds both\n"
+                     "                                      rotated pairs.\n" );
+   fprintf ( stdout, "  -M, --multi-query         <int>     Compare the first input sequence against\n"
+                     "                                      all the others with saCSC, advancing the\n"
+                     "                                      scans of this many queries together over\n"
+                     "                                      one pass of x (e.g. 8; pick it so that\n"
+                     "                                      their diff arrays fit in L2). One row per\n"
+                     "                                      query is written to the output file.\n" );
+   fprintf ( stdout, "  -p, --pairs-file          <str>     Compare the pairs of input sequences\n"
+                     "                                      listed in this file, two ids per line,\n"
+                     "                                      with saCSC on one collection index and\n"
+                     "                                      write one row per pair to the output\n"
+                     "                                      file. Here and with -A, pairs of equal\n"
+                     "                                      lengths are scanned 8 at a time.\n" );
+   fprintf ( stdout, "  -K, --anchor-length       <int>     Estimate the rotation with saCSC from the\n"
+                     "                                      exact matches of at least this length\n"
+                     "                                      between x and y (e.g. 12): every match\n"
+                     "                                      votes for its offset and only the most\n"
+                     "                                      voted rotations are scanned. With -P the\n"
+                     "                                      estimate seeds the refinement.\n" );
+   fprintf ( stdout, "  -F, --fft-candidates      <int>     Estimate the rotation with saCSC from this\n"
+                     "                                      many rotations with the most letter\n"
+                     "                                      matches, found by FFT cross-correlation\n"
+                     "                                      in O(m log m) (e.g. 32); only they are\n"
+                     "                                      scanned. May be combined with -K.\n" );
+   fprintf ( stdout, "  -S, --stride              <int>     Search the rotations coarse to fine with\n"
+                     "                                      saCSC: evaluate every rotation on this\n"
+                     "                                      stride (e.g. 1000), then scan the -C gaps\n"
+                     "                                      between them that may hold a lower\n"
+                     "                                      distance. Reports whether the\n"
+                     "                                      exhaustive minimum is provably matched.\n"
+                     "                                      A coarse rotation costs about m + n\n"
+                     "                                      steps and a scanned one about 2m / l, so\n"
+                     "                                      strides up to (m + n) l / 2m cannot beat\n"
+                     "                                      the exhaustive scan and are raised; 0\n"
+                     "                                      picks the stride balancing the coarse\n"
+                     "                                      rotations with the -C gaps.\n" );
+   fprintf ( stdout, "  -C, --candidates          <int>     The number of gaps to scan with -S; more\n"
+                     "                                      are more accurate and slower (default: 8,\n"
+                     "                                      or all the gaps that may hold a lower\n"
+                     "                                      distance with -t). With hCSC, the number\n"
+                     "                                      of best blocks whose neighbourhoods are\n"
+                     "                                      refined (default: 1).\n" );
+   fprintf ( stdout, "  -t, --time-limit          <float>   Stop the search after this many seconds\n"
+                     "                                      and report the best rotation so far and\n"
+                     "                                      whether the search completed. saCSC then\n"
+                     "                                      stops its scan (or its -S search) early,\n"
+                     "                                      hCSC skips or cuts short its refine step\n"
+                     "                                      and -P refinement stops partway.\n" );
+   fprintf ( stdout, "  -U, --memory-limit        <float>   The MB the engine chosen by -m auto may\n"
+                     "                                      use (default: no limit), and the MB of\n"
+                     "                                      diff tables a q or l of 0 is tuned to\n"
+                     "                                      (default: 512).\n" );
+   fprintf ( stdout, "  -H, --allow-heuristic     <void>    Let -m auto choose hCSC, whose result may\n"
+                     "                                      not be the minimum distance.\n" );
+   fprintf ( stdout, "  -T, --threads             <int>     Number of threads (default: 1). With more\n"
+                     "                                      than one, saCSC ranks the q-grams by\n"
+                     "                                      parallel bucket sorting instead of a\n"
+                     "                                      suffix array and hCSC refines its -C\n"
+                     "                                      candidates concurrently.\n" );
    fprintf ( stdout, " Other:\n" );
    fprintf ( stdout, "  -h, --help                <void>    This help message.\n");
 }
@@ -203,6 +490,81 @@ double gettime( void )
 }
 
 
+/* Shared by the threads of a comparison, which all poll the same deadline */
+static std::atomic<double>       deadline ( 0.0 );        // the time the search must stop at, 0 for none
+static std::atomic<unsigned int> deadline_hit ( 0 );      // whether the deadline has passed
+
+/*
+Starts the time limit of the comparison: from now on deadline_passed ()
+reports whether seconds have passed
+*/
+void deadline_start ( double seconds )
+{
+    deadline = ( seconds > 0 ) ? gettime() + seconds : 0.0;
+    deadline_hit = 0;
+}
+
+/*
+Returns 1 once the deadline has passed; callers check it before the work
+they would skip and, in hot loops, only every few iterations
+*/
+unsigned int deadline_passed ( void )
+{
+    if ( deadline_hit )
+        return ( 1 );
+    double d = deadline;
+    if ( d > 0 && gettime() >= d )
+        deadline_hit = 1;
+    return ( deadline_hit );
+}
+
+/*
+Returns 1 if a search was stopped by the deadline
+*/
+unsigned int deadline_expired ( void )
+{
+    return ( deadline_hit );
+}
+
+
+/*
+Booth's algorithm: returns the starting position of the lexicographically
+least rotation of x[0..m-1] in linear time
+*/
+unsigned int least_rotation ( unsigned char * x, unsigned int m )
+{
+    int * f;
+    unsigned int k = 0;
+
+    if ( m == 0 || ( f = ( int * ) malloc ( 2 * m * sizeof ( int ) ) ) == NULL )
+        return ( 0 );
+    for ( unsigned int j = 0; j < 2 * m; j++ )	f[j] = -1;
+
+    for ( unsigned int j = 1; j < 2 * m; j++ )
+    {
+        unsigned char c = x[j % m];
+        int i = f[j - k - 1];
+        while ( i != -1 && c != x[( k + i + 1 ) % m] )
+        {
+            if ( c < x[( k + i + 1 ) % m] )
+                k = j - i - 1;
+            i = f[i];
+        }
+        if ( c != x[( k + i + 1 ) % m] )	// i == -1
+        {
+            if ( c < x[k % m] )
+                k = j;
+            f[j - k] = -1;
+        }
+        else
+            f[j - k] = i + 1;
+    }
+    free ( f );
+
+    return ( k % m );
+}
+
+
 void create_rotation ( unsigned char * x, unsigned int offset, unsigned char * rotation )
 {
     unsigned int m = strlen ( ( char * ) x );
@@ -210,3 +572,373 @@ void create_rotation ( unsigned char * x, unsigned int offset, unsigned char * r
     memmove ( &rotation[m - offset], &x[0], offset );
     rotation[m] = '\0';
 }
+
+
+/*
+Initialise a bounded heap keeping the k best (smallest distance) rotations,
+with a hash table of at least 2k cells finding the heap index of a rotation
+*/
+int topk_init ( struct TTopK * top, unsigned int k )
+{
+    top -> k    = k;
+    top -> size = 0;
+    top -> bits = 1;
+    while ( ( 1ULL << top -> bits ) < 2ULL * k )	top -> bits++;
+    top -> occ  = ( TPOcc * ) calloc ( k, sizeof ( TPOcc ) );
+    top -> slot = ( unsigned int * ) calloc ( 1ULL << top -> bits, sizeof ( unsigned int ) );
+    if ( top -> occ == NULL || top -> slot == NULL )
+    {
+        fprintf ( stderr, " Error: Cannot allocate memory for the top-k heap.\n" );
+        return ( 0 );
+    }
+    return ( 1 );
+}
+
+/* a is worse than b: larger distance, or equal distance and later rotation */
+static inline int topk_worse ( TPOcc * a, TPOcc * b )
+{
+    return ( a -> err > b -> err || ( a -> err == b -> err && a -> rot > b -> rot ) );
+}
+
+static inline unsigned int topk_hash ( struct TTopK * top, unsigned int rot )
+{
+    return ( ( rot * 2654435761U ) >> ( 32 - top -> bits ) );
+}
+
+/* The cell holding rot, or the empty cell where it would go */
+static unsigned int topk_cell ( struct TTopK * top, unsigned int rot )
+{
+    unsigned int mask = ( 1U << top -> bits ) - 1;
+    unsigned int c = topk_hash ( top, rot );
+    while ( top -> slot[c] && top -> occ[top -> slot[c] - 1] . rot != rot )
+        c = ( c + 1 ) & mask;
+    return ( c );
+}
+
+/* Empties cell c, moving back the rotations probed past it */
+static void topk_erase ( struct TTopK * top, unsigned int c )
+{
+    unsigned int mask = ( 1U << top -> bits ) - 1;
+    for ( unsigned int j = ( c + 1 ) & mask; top -> slot[j]; j = ( j + 1 ) & mask )
+    {
+        unsigned int h = topk_hash ( top, top -> occ[top -> slot[j] - 1] . rot );
+        if ( ( ( j - h ) & mask ) >= ( ( j - c ) & mask ) )
+        {
+            top -> slot[c] = top -> slot[j];
+            c = j;
+        }
+    }
+    top -> slot[c] = 0;
+}
+
+static void topk_swap ( struct TTopK * top, unsigned int i, unsigned int j )
+{
+    unsigned int ci = topk_cell ( top, top -> occ[i] . rot );
+    unsigned int cj = topk_cell ( top, top -> occ[j] . rot );
+    TPOcc t = top -> occ[i]; top -> occ[i] = top -> occ[j]; top -> occ[j] = t;
+    top -> slot[ci] = j + 1;
+    top -> slot[cj] = i + 1;
+}
+
+static void topk_sift_up ( struct TTopK * top, unsigned int i )
+{
+    while ( i > 0 && topk_worse ( &top -> occ[i], &top -> occ[( i - 1 ) / 2] ) )
+    {
+        topk_swap ( top, i, ( i - 1 ) / 2 );
+        i = ( i - 1 ) / 2;
+    }
+}
+
+static void topk_sift_down ( struct TTopK * top, unsigned int size, unsigned int i )
+{
+    TPOcc * h = top -> occ;
+    while ( 2 * i + 1 < size )
+    {
+        unsigned int c = 2 * i + 1;
+        if ( c + 1 < size && topk_worse ( &h[c + 1], &h[c] ) ) c++;
+        if ( ! topk_worse ( &h[c], &h[i] ) ) break;
+        topk_swap ( top, i, c );
+        i = c;
+    }
+}
+
+/*
+Offer a rotation to the heap; the worst of the k kept rotations sits at the
+root. A rotation offered again keeps the better of its two distances.
+*/
+void topk_push ( struct TTopK * top, unsigned int err, unsigned int rot )
+{
+    TPOcc o;
+    o . err = err;
+    o . rot = rot;
+
+    if ( top -> size == top -> k && ! topk_worse ( &top -> occ[0], &o ) )
+        return;
+
+    unsigned int c = topk_cell ( top, rot );
+    if ( top -> slot[c] )	//the same rotation may be evaluated twice
+    {
+        unsigned int i = top -> slot[c] - 1;
+        if ( topk_worse ( &top -> occ[i], &o ) )
+        {
+            top -> occ[i] = o;
+            topk_sift_down ( top, top -> size, i );
+        }
+        return;
+    }
+
+    if ( top -> size < top -> k )
+    {
+        unsigned int i = top -> size++;
+        top -> occ[i] = o;
+        top -> slot[c] = i + 1;
+        topk_sift_up ( top, i );
+    }
+    else
+    {
+        topk_erase ( top, topk_cell ( top, top -> occ[0] . rot ) );
+        top -> occ[0] = o;
+        top -> slot[topk_cell ( top, rot )] = 1;
+        topk_sift_down ( top, top -> size, 0 );
+    }
+}
+
+/*
+Turn the heap into a list sorted from the best to the worst rotation
+*/
+void topk_sort ( struct TTopK * top )
+{
+    for ( unsigned int s = top -> size; s > 1; s-- )
+    {
+        topk_swap ( top, 0, s - 1 );
+        topk_sift_down ( top, s - 1, 0 );
+    }
+}
+
+void topk_free ( struct TTopK * top )
+{
+    free ( top -> occ );
+    free ( top -> slot );
+    top -> occ  = NULL;
+    top -> slot = NULL;
+    top -> size = 0;
+}
+
+/*
+Open a distance profile file. The file holds the magic `CSCP', a version
+number and the number of rotations (32-bit each), followed by runs of
+(distance, run length) pairs of 32-bit unsigned integers.
+*/
+int profile_open ( struct TProfile * profile, char * filename, unsigned int num )
+{
+    unsigned int header[2] = { 1, num };
+
+    if ( ! ( profile -> fd = fopen ( filename, "wb" ) ) )
+    {
+        fprintf ( stderr, " Error: Cannot open file %s!\n", filename );
+        return ( 0 );
+    }
+    setvbuf ( profile -> fd, NULL, _IOFBF, ALLOC_SIZE );
+    fwrite ( "CSCP", sizeof ( char ), 4, profile -> fd );
+    fwrite ( header, sizeof ( unsigned int ), 2, profile -> fd );
+    profile -> err = 0;
+    profile -> run = 0;
+    return ( 1 );
+}
+
+void profile_push ( struct TProfile * profile, unsigned int err )
+{
+    if ( profile -> run > 0 && profile -> err != err )
+    {
+        unsigned int rec[2] = { profile -> err, profile -> run };
+        fwrite ( rec, sizeof ( unsigned int ), 2, profile -> fd );
+        profile -> run = 0;
+    }
+    profile -> err = err;
+    profile -> run++;
+}
+
+int profile_close ( struct TProfile * profile )
+{
+    if ( profile -> run > 0 )
+    {
+        unsigned int rec[2] = { profile -> err, profile -> run };
+        fwrite ( rec, sizeof ( unsigned int ), 2, profile -> fd );
+    }
+    if ( fclose ( profile -> fd ) )
+    {
+        fprintf ( stderr, " Error: file close error!\n" );
+        return ( 0 );
+    }
+    return ( 1 );
+}
+
+
+/*
+Read the (Multi)FASTA file in memory
+*/
+int read_fasta ( char * input_filename, char * alphabet, unsigned char *** seq_out, unsigned char *** seq_id_out, unsigned int * num_seqs_out )
+{
+        FILE *           in_fd;                  // the input file descriptor
+        unsigned char ** seq    = NULL;          // the sequence in memory
+        unsigned char ** seq_id = NULL;          // the sequence id in memory
+        char c;
+        unsigned int num_seqs = 0;           	// the total number of sequences considered
+        unsigned int total_length = 0;          // the total number of sequences considered
+        unsigned int max_alloc_seq_id = 0;
+        unsigned int max_alloc_seq = 0;
+
+        if ( ! ( in_fd = fopen ( input_filename, "r") ) )
+        {
+                fprintf ( stderr, " Error: Cannot open file %s!\n", input_filename );
+                return ( 0 );
+        }
+
+        c = fgetc( in_fd );
+        do
+        {
+                if ( c != '>' )
+                {
+                        fprintf ( stderr, " Error: input file %s is not in FASTA format!\n", input_filename );
+                        return ( 0 );
+                }
+                else
+                {
+                        if ( num_seqs >= max_alloc_seq_id )
+                        {
+                                seq_id = ( unsigned char ** ) realloc ( seq_id,   ( max_alloc_seq_id + ALLOC_SIZE ) * sizeof ( unsigned char * ) );
+                                max_alloc_seq_id += ALLOC_SIZE;
+                        }
+
+                        unsigned int max_alloc_seq_id_len = 0;
+                        unsigned int seq_id_len = 0;
+
+                        seq_id[ num_seqs ] = NULL;
+
+                        while ( ( c = fgetc( in_fd ) ) != EOF && c != '\n' )
+                        {
+                                if ( seq_id_len >= max_alloc_seq_id_len )
+                                {
+                                        seq_id[ num_seqs ] = ( unsigned char * ) realloc ( seq_id[ num_seqs ],   ( max_alloc_seq_id_len + ALLOC_SIZE ) * sizeof ( unsigned char ) );
+                                        max_alloc_seq_id_len += ALLOC_SIZE;
+                                }
+                                seq_id[ num_seqs ][ seq_id_len++ ] = c;
+                        }
+                        seq_id[ num_seqs ][ seq_id_len ] = '\0';
+
+                }
+		if ( num_seqs >= max_alloc_seq )
+                {
+                        seq = ( unsigned char ** ) realloc ( seq,   ( max_alloc_seq + ALLOC_SIZE ) * sizeof ( unsigned char * ) );
+                        max_alloc_seq += ALLOC_SIZE;
+                }
+
+                unsigned int seq_len = 0;
+                unsigned int max_alloc_seq_len = 0;
+
+                seq[ num_seqs ] = NULL;
+
+                while ( ( c = fgetc( in_fd ) ) != EOF && c != '>' )
+                {
+                        if( seq_len == 0 && c == '\n' )
+                        {
+                                fprintf ( stderr, " Omitting empty sequence in file %s!\n", input_filename );
+                                c = fgetc( in_fd );
+                                break;
+                        }
+                        if( c == '\n' || c == ' ' ) continue;
+
+                        c = toupper( c );
+
+                        if ( seq_len >= max_alloc_seq_len )
+                        {
+                                seq[ num_seqs ] = ( unsigned char * ) realloc ( seq[ num_seqs ],   ( max_alloc_seq_len + ALLOC_SIZE ) * sizeof ( unsigned char ) );
+                                max_alloc_seq_len += ALLOC_SIZE;
+                        }
+
+                        if( strchr ( alphabet, c ) )
+                        {
+                                seq[ num_seqs ][ seq_len++ ] = c;
+                        }
+                        else
+                        {
+                                fprintf ( stderr, " Error: input file %s contains an unexpected character %c!\n", input_filename, c );
+                                return ( 0 );
+                        }
+
+                }
+
+                if( seq_len != 0 )
+                {
+                        if ( seq_len >= max_alloc_seq_len )
+                        {
+                                seq[ num_seqs ] = ( unsigned char * ) realloc ( seq[ num_seqs ],   ( max_alloc_seq_len + ALLOC_SIZE ) * sizeof ( unsigned char ) );
+                                max_alloc_seq_len += ALLOC_SIZE;
+                        }
+                        seq[ num_seqs ][ seq_len ] = '\0';
+                        total_length += seq_len;
+                        num_seqs++;
+                }
+
+        } while( c != EOF );
+
+	if ( fclose ( in_fd ) )
+	{
+		fprintf( stderr, " Error: file close error!\n");
+		return ( 0 );
+	}
+
+        ( * seq_out )      = seq;
+        ( * seq_id_out )   = seq_id;
+        ( * num_seqs_out ) = num_seqs;
+        return ( 1 );
+}
+
+
+/*
+Read the first max_seqs sequences of a packed container in memory; only those are decoded
+*/
+int read_packed ( char * input_filename, char * alphabet, unsigned int max_seqs, unsigned char *** seq_out, unsigned char *** seq_id_out, unsigned int * num_seqs_out, unsigned int * total_seqs_out )
+{
+        struct TPack p;
+
+        if ( ! pack_open ( input_filename, &p ) )
+                return ( 0 );
+
+        unsigned int total_seqs = pack_num_seqs ( &p );
+        unsigned int num_seqs = cscmin ( total_seqs, max_seqs );
+        unsigned char ** seq = ( unsigned char ** ) calloc ( num_seqs + 1, sizeof ( unsigned char * ) );
+        unsigned char ** seq_id = ( unsigned char ** ) calloc ( num_seqs + 1, sizeof ( unsigned char * ) );
+
+        for ( unsigned int i = 0; i < num_seqs; i++ )
+        {
+                uint64_t len = pack_length ( &p, i );
+                char * id = pack_id ( &p, i );
+
+                seq[i] = ( unsigned char * ) malloc ( ( len + 1 ) * sizeof ( unsigned char ) );
+                seq_id[i] = ( unsigned char * ) malloc ( ( strlen ( id ) + 1 ) * sizeof ( unsigned char ) );
+                if ( seq[i] == NULL || seq_id[i] == NULL )
+                {
+                        fprintf ( stderr, " Error: Cannot allocate memory for sequence %s!\n", id );
+                        return ( 0 );
+                }
+                strcpy ( ( char * ) seq_id[i], id );
+                pack_decode ( &p, i, seq[i] );
+
+                for ( uint64_t j = 0; j < len; j++ )
+                {
+                        if ( ! strchr ( alphabet, seq[i][j] ) )
+                        {
+                                fprintf ( stderr, " Error: input file %s contains an unexpected character %c!\n", input_filename, seq[i][j] );
+                                return ( 0 );
+                        }
+                }
+        }
+        pack_close ( &p );
+
+        ( * seq_out )        = seq;
+        ( * seq_id_out )     = seq_id;
+        ( * num_seqs_out )   = num_seqs;
+        ( * total_seqs_out ) = total_seqs;
+        return ( 1 );
+}